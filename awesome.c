@@ -39,6 +39,7 @@
 #include "event.h"
 #include "property.h"
 #include "screen.h"
+#include "gc.h"
 #include "common/version.h"
 #include "common/atoms.h"
 #include "config.h"
@@ -182,11 +183,25 @@ scan(void)
     }
 }
 
+/** Wakes the event loop up while property changes are pending. */
+static ev_idle property_wakeup;
+
+static void
+a_property_wakeup_cb(EV_P_ ev_idle *w, int revents)
+{
+    ev_idle_stop(EV_A_ w);
+}
+
 static void
 a_xcb_check_cb(EV_P_ ev_check *w, int revents)
 {
     xcb_event_poll_for_event_loop(&globalconf.evenths);
+    client_property_flush();
     awesome_refresh(globalconf.connection);
+    /* changes made by the property hook or by the refresh itself are
+     * reported on next iteration */
+    if(globalconf.property_pending.len)
+        ev_idle_start(EV_A_ &property_wakeup);
 }
 
 static void
@@ -406,6 +421,10 @@ main(int argc, char **argv)
     ev_check_init(&xcheck, &a_xcb_check_cb);
     ev_check_start(globalconf.loop, &xcheck);
     ev_unref(globalconf.loop);
+    ev_idle_init(&property_wakeup, &a_property_wakeup_cb);
+
+    /* collect Lua garbage while idle */
+    gc_init();
 
     /* Allocate a handler which will holds all errors and events */
     xcb_event_handlers_init(globalconf.connection, &globalconf.evenths);
@@ -453,6 +472,7 @@ main(int argc, char **argv)
                                            "white", sizeof("white") - 1);
 
     globalconf.font = draw_font_new("sans 8");
+    globalconf.icon_size = 64;
 
     /* init cursors */
     globalconf.cursor[CurNormal] = xutil_cursor_new(globalconf.connection, XUTIL_CURSOR_LEFT_PTR);
@@ -524,6 +544,7 @@ main(int argc, char **argv)
     /* cleanup event loop */
     ev_ref(globalconf.loop);
     ev_check_stop(globalconf.loop, &xcheck);
+    ev_idle_stop(globalconf.loop, &property_wakeup);
     ev_ref(globalconf.loop);
     ev_io_stop(globalconf.loop, &xio);
 
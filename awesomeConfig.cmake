@@ -14,6 +14,7 @@ set(CMAKE_BUILD_TYPE RELEASE)
 set(CURSES_NEED_NCURSES true)
 
 option(WITH_DBUS "build with D-BUS" ON)
+option(WITH_JPEG "decode JPEG images in the background with libjpeg" ON)
 option(GENERATE_MANPAGES "generate manpages" ON)
 option(GENERATE_LUADOC "generate luadoc" ON)
 
@@ -161,6 +162,9 @@ endmacro()
 a_find_library(LIB_READLINE readline)
 a_find_library(LIB_EV ev)
 
+# Check for threads, used to load images and run workers in the background
+find_package(Threads REQUIRED)
+
 # Error check
 set( LUA_FOUND LUA51_FOUND OR LUA50_FOUND )# This is a workaround to a cmake bug
 if(NOT LUA_FOUND)
@@ -171,6 +175,7 @@ set(AWESOME_REQUIRED_LIBRARIES
     ${AWESOME_COMMON_REQUIRED_LIBRARIES}
     ${AWESOME_REQUIRED_LIBRARIES}
     ${LIB_EV}
+    ${CMAKE_THREAD_LIBS_INIT}
     ${LUA_LIBRARIES})
 
 set(AWESOME_REQUIRED_INCLUDE_DIRS
@@ -204,6 +209,17 @@ if(WITH_DBUS)
         message(STATUS "DBUS not found. Disabled.")
     endif()
 endif()
+
+if(WITH_JPEG)
+    find_package(JPEG)
+    if(JPEG_FOUND)
+        set(AWESOME_OPTIONAL_LIBRARIES ${AWESOME_OPTIONAL_LIBRARIES} ${JPEG_LIBRARIES})
+        set(AWESOME_OPTIONAL_INCLUDE_DIRS ${AWESOME_OPTIONAL_INCLUDE_DIRS} ${JPEG_INCLUDE_DIR})
+    else()
+        set(WITH_JPEG OFF)
+        message(STATUS "libjpeg not found. Disabled.")
+    endif()
+endif()
 # }}}
 
 # {{{ Install path and configuration variables
@@ -0,0 +1,102 @@
+-- Compare the CPU cost of native samplers with the usual Lua way of
+-- reading /proc and /sys, io.open() plus patterns.
+-- It has to run inside awesome, e.g.:
+--   echo 'return loadfile("/path/to/sampler-bench.lua")(1000)' | awesome-client
+-- The optional argument is the number of samples of each kind.
+
+local n = ... or 1000
+
+local function read(path, what)
+    local f = io.open(path)
+    if not f then return end
+    local s = f:read(what)
+    f:close()
+    return s
+end
+
+local prev = {}
+
+local lua_samplers =
+{
+    cpu = function ()
+        local user, nice, system, idle, iowait, irq, softirq, steal =
+            read("/proc/stat", "*l"):match("^cpu%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)%s+(%d+)")
+        local total = user + nice + system + idle + iowait + irq + softirq + steal
+        local usage
+        if prev.cpu_total and total > prev.cpu_total then
+            local dtotal = total - prev.cpu_total
+            usage = 100 * (dtotal - (idle - prev.cpu_idle) - (iowait - prev.cpu_iowait)) / dtotal
+        end
+        prev.cpu_total, prev.cpu_idle, prev.cpu_iowait = total, idle, iowait
+        return usage
+    end,
+    memory = function ()
+        local s = read("/proc/meminfo", "*a")
+        local total = tonumber(s:match("MemTotal:%s*(%d+)"))
+        local available = tonumber(s:match("MemAvailable:%s*(%d+)"))
+        local swap_total = tonumber(s:match("SwapTotal:%s*(%d+)"))
+        local swap_free = tonumber(s:match("SwapFree:%s*(%d+)"))
+        return 100 * (total - available) / total,
+               swap_total > 0 and 100 * (swap_total - swap_free) / swap_total or 0
+    end,
+    net = function (iface)
+        local s = read("/proc/net/dev", "*a")
+        local rx, tx = s:match(iface:gsub("%p", "%%%0") .. ":%s*(%d+)%s+%d+%s+%d+%s+%d+%s+%d+%s+%d+%s+%d+%s+%d+%s+(%d+)")
+        return tonumber(rx), tonumber(tx)
+    end,
+    battery = function (name)
+        return tonumber(read("/sys/class/power_supply/" .. name .. "/capacity", "*l"))
+    end,
+    thermal = function (zone)
+        return tonumber(read("/sys/class/thermal/thermal_zone" .. zone .. "/temp", "*l")) / 1000
+    end,
+}
+
+local function first_interface()
+    for line in io.lines("/proc/net/dev") do
+        local iface = line:match("^%s*([^%s:]+):")
+        if iface and iface ~= "lo" then return iface end
+    end
+    return "lo"
+end
+
+local kinds =
+{
+    { "cpu", {}, nil },
+    { "memory", {}, nil },
+    { "net", { interface = first_interface() }, first_interface() },
+    { "battery", { name = "BAT0" }, "BAT0" },
+    { "thermal", { zone = 0 }, 0 },
+}
+
+local report = { string.format("%d samples of each kind, CPU time in seconds", n) }
+
+for _, kind in ipairs(kinds) do
+    local name, opts, arg = kind[1], kind[2], kind[3]
+    local s = sampler(name, 3600, opts)
+
+    if not s then
+        table.insert(report, string.format("%-8s unavailable", name))
+    else
+        s:stop()
+
+        collectgarbage("collect")
+        local t = os.clock()
+        for i = 1, n do
+            s:sample()
+        end
+        local native = os.clock() - t
+
+        collectgarbage("collect")
+        t = os.clock()
+        for i = 1, n do
+            lua_samplers[name](arg)
+        end
+        local lua = os.clock() - t
+
+        table.insert(report, string.format("%-8s native %.4f  lua %.4f  ratio %.1f",
+                                           name, native, lua, native > 0 and lua / native or 0))
+    end
+end
+
+return table.concat(report, "\n")
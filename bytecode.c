@@ -0,0 +1,357 @@
+/*
+ * bytecode.c - Lua bytecode cache
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <ev.h>
+
+#include <lauxlib.h>
+
+#include "structs.h"
+#include "bytecode.h"
+#include "common/buffer.h"
+
+extern awesome_t globalconf;
+
+/** Cached chunk file header, followed by the source path and the chunk. */
+typedef struct
+{
+    char magic[4];
+    int32_t version;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint32_t path_len;
+} bytecode_header_t;
+
+#define BYTECODE_MAGIC "AWBC"
+
+/** How a Lua file has been loaded */
+typedef struct
+{
+    char *path;
+    /** Seconds spent loading */
+    double time;
+    /** True if it came from the cache */
+    bool cached;
+} bytecode_load_t;
+
+static inline void
+bytecode_load_wipe(bytecode_load_t *load)
+{
+    p_delete(&load->path);
+}
+
+DO_ARRAY(bytecode_load_t, bytecode_load, bytecode_load_wipe)
+
+/** The cache directory, NULL if caching is disabled */
+static char *bytecode_dir;
+/** Every file loaded */
+static bytecode_load_array_t bytecode_loads;
+
+/** Create a directory and its parents.
+ * \param path The directory path, modified while working.
+ * \return True if the directory exists.
+ */
+static bool
+bytecode_mkdir(char *path)
+{
+    for(char *p = path + 1; *p; p++)
+        if(*p == '/')
+        {
+            *p = '\0';
+            if(mkdir(path, 0700) && errno != EEXIST)
+                return false;
+            *p = '/';
+        }
+    return !mkdir(path, 0700) || errno == EEXIST;
+}
+
+/** Get the cache file path of a source file.
+ * \param path The source file path.
+ * \return A new string.
+ */
+static char *
+bytecode_cache_path(const char *path)
+{
+    /* FNV-1a */
+    uint64_t hash = 14695981039346656037ULL;
+    char *cache;
+
+    for(const char *p = path; *p; p++)
+        hash = (hash ^ (unsigned char) *p) * 1099511628211ULL;
+
+    a_asprintf(&cache, "%s/%016llx.luac", bytecode_dir, (unsigned long long) hash);
+    return cache;
+}
+
+/** Fill a cache header for a source file.
+ * \param header The header.
+ * \param path The source file path.
+ * \param st The source file status.
+ */
+static void
+bytecode_header_init(bytecode_header_t *header, const char *path, const struct stat *st)
+{
+    p_clear(header, 1);
+    memcpy(header->magic, BYTECODE_MAGIC, sizeof(header->magic));
+    header->version = LUA_VERSION_NUM;
+    header->mtime = st->st_mtim.tv_sec;
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+    header->size = st->st_size;
+    header->path_len = a_strlen(path);
+}
+
+/** Load a cached chunk if it is fresh.
+ * \param L The Lua VM state.
+ * \param path The source file path.
+ * \param st The source file status.
+ * \param cache The cache file path.
+ * \return True if the chunk has been pushed.
+ */
+static bool
+bytecode_cache_load(lua_State *L, const char *path, const struct stat *st,
+                    const char *cache)
+{
+    bytecode_header_t header, expected;
+    struct stat cst;
+    char *data = NULL;
+    ssize_t len;
+    bool ret = false;
+    int fd;
+
+    if((fd = open(cache, O_RDONLY | O_CLOEXEC)) < 0)
+        return false;
+
+    bytecode_header_init(&expected, path, st);
+
+    if(fstat(fd, &cst)
+       || cst.st_size <= (off_t) (sizeof(header) + expected.path_len)
+       || read(fd, &header, sizeof(header)) != sizeof(header)
+       || memcmp(&header, &expected, sizeof(header)))
+        goto bailout;
+
+    len = cst.st_size - sizeof(header);
+    data = p_new(char, len);
+    if(read(fd, data, len) != len
+       || memcmp(data, path, header.path_len))
+        goto bailout;
+
+    if(luaL_loadbuffer(L, data + header.path_len, len - header.path_len, path))
+        lua_pop(L, 1);
+    else
+        ret = true;
+
+  bailout:
+    p_delete(&data);
+    close(fd);
+    return ret;
+}
+
+static int
+bytecode_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    buffer_add(ud, p, sz);
+    return 0;
+}
+
+/** Write the chunk on top of the stack to the cache.
+ * \param L The Lua VM state.
+ * \param path The source file path.
+ * \param st The source file status.
+ * \param cache The cache file path.
+ */
+static void
+bytecode_cache_store(lua_State *L, const char *path, const struct stat *st,
+                     const char *cache)
+{
+    bytecode_header_t header;
+    buffer_t buf;
+    char *tmp;
+    int fd;
+
+    bytecode_header_init(&header, path, st);
+
+    buffer_init(&buf);
+    buffer_add(&buf, &header, sizeof(header));
+    buffer_add(&buf, path, header.path_len);
+    lua_dump(L, bytecode_writer, &buf);
+
+    /* write then rename, so that a cache file is always complete */
+    a_asprintf(&tmp, "%s.%d", cache, getpid());
+    if((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) >= 0)
+    {
+        bool ok = write(fd, buf.s, buf.len) == buf.len;
+
+        if(close(fd) || !ok || rename(tmp, cache))
+            unlink(tmp);
+    }
+    p_delete(&tmp);
+    buffer_wipe(&buf);
+}
+
+/** Load a Lua file like luaL_loadfile(), using the bytecode cache.
+ * A cached chunk is used if the source file size and modification time and
+ * the Lua version are the ones it was compiled from.
+ * \param L The Lua VM state.
+ * \param path The file path.
+ * \return 0 on success, like luaL_loadfile().
+ */
+int
+bytecode_loadfile(lua_State *L, const char *path)
+{
+    ev_tstamp start = ev_time();
+    bytecode_load_t load = { .cached = false };
+    struct stat st;
+    char *cache = NULL;
+    int ret = 0;
+
+    if(bytecode_dir && !stat(path, &st))
+    {
+        cache = bytecode_cache_path(path);
+        load.cached = bytecode_cache_load(L, path, &st, cache);
+    }
+
+    if(!load.cached && !(ret = luaL_loadfile(L, path)) && cache)
+        bytecode_cache_store(L, path, &st, cache);
+
+    p_delete(&cache);
+
+    if(!ret)
+    {
+        load.path = a_strdup(path);
+        load.time = ev_time() - start;
+        bytecode_load_array_append(&bytecode_loads, load);
+    }
+
+    return ret;
+}
+
+/** Lua file searcher for require, using the bytecode cache.
+ * It replaces the standard one, and looks for files along package.path.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+bytecode_searcher(lua_State *L)
+{
+    const char *name = luaL_checkstring(L, 1);
+    const char *path, *fname, *sep;
+    luaL_Buffer msg;
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "path");
+    if(!(path = lua_tostring(L, -1)))
+        luaL_error(L, "package.path must be a string");
+
+    fname = luaL_gsub(L, name, ".", LUA_DIRSEP);
+    luaL_buffinit(L, &msg);
+
+    for(; *path; path = *sep ? sep + 1 : sep)
+    {
+        const char *filename;
+
+        if(!(sep = strchr(path, *LUA_PATHSEP)))
+            sep = path + a_strlen(path);
+        if(sep == path)
+            continue;
+
+        lua_pushlstring(L, path, sep - path);
+        filename = luaL_gsub(L, lua_tostring(L, -1), LUA_PATH_MARK, fname);
+        lua_remove(L, -2);
+
+        if(!access(filename, R_OK))
+        {
+            if(bytecode_loadfile(L, filename))
+                luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+                           name, filename, lua_tostring(L, -1));
+            return 1;
+        }
+
+        lua_pushfstring(L, "\n\tno file '%s'", filename);
+        lua_remove(L, -2);
+        luaL_addvalue(&msg);
+    }
+
+    luaL_pushresult(&msg);
+    return 1;
+}
+
+/** Set up the bytecode cache directory and the require searcher.
+ * \param L The Lua VM state.
+ */
+void
+bytecode_init(lua_State *L)
+{
+    const char *dir;
+
+    if((dir = getenv("XDG_CACHE_HOME")))
+        a_asprintf(&bytecode_dir, "%s" BYTECODE_CACHE_DIR, dir);
+    else if((dir = getenv("HOME")))
+        a_asprintf(&bytecode_dir, "%s/.cache" BYTECODE_CACHE_DIR, dir);
+
+    if(bytecode_dir && !bytecode_mkdir(bytecode_dir))
+    {
+        warn("cannot create %s, bytecode cache disabled: %s", bytecode_dir, strerror(errno));
+        p_delete(&bytecode_dir);
+    }
+
+    /* package.loaders[2] is the Lua file searcher */
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "loaders");
+    lua_pushcfunction(L, bytecode_searcher);
+    lua_rawseti(L, -2, 2);
+    lua_pop(L, 2);
+}
+
+/** Get the loading statistics of Lua files.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn A table with, for each file loaded, a table with `path', `time'
+ * spent loading in seconds, and `cached', true if it came from the bytecode
+ * cache.
+ */
+int
+luaA_bytecode_stats(lua_State *L)
+{
+    lua_createtable(L, bytecode_loads.len, 0);
+
+    for(int i = 0; i < bytecode_loads.len; i++)
+    {
+        lua_createtable(L, 0, 3);
+        lua_pushstring(L, bytecode_loads.tab[i].path);
+        lua_setfield(L, -2, "path");
+        lua_pushnumber(L, bytecode_loads.tab[i].time);
+        lua_setfield(L, -2, "time");
+        lua_pushboolean(L, bytecode_loads.tab[i].cached);
+        lua_setfield(L, -2, "cached");
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    return 1;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
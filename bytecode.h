@@ -0,0 +1,35 @@
+/*
+ * bytecode.h - Lua bytecode cache header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_BYTECODE_H
+#define AWESOME_BYTECODE_H
+
+#include <lua.h>
+
+/** Cache directory, relative to XDG_CACHE_HOME. */
+#define BYTECODE_CACHE_DIR "/awesome/bytecode"
+
+void bytecode_init(lua_State *);
+int bytecode_loadfile(lua_State *, const char *);
+int luaA_bytecode_stats(lua_State *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
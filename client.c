@@ -406,8 +406,8 @@ void
 client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, int phys_screen, int screen)
 {
     xcb_get_property_cookie_t ewmh_icon_cookie;
+    xcb_get_property_reply_t *ewmh_icon_r;
     client_t *c;
-    image_t *icon;
     const uint32_t select_input_val[] =
     {
         XCB_EVENT_MASK_STRUCTURE_NOTIFY
@@ -438,8 +438,9 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, int phys_screen,
     c->geometry.width = c->f_geometry.width = c->m_geometry.width = wgeom->width;
     c->geometry.height = c->f_geometry.height = c->m_geometry.height = wgeom->height;
     client_setborder(c, wgeom->border_width);
-    if((icon = ewmh_window_icon_get_reply(ewmh_icon_cookie)))
-        c->icon = image_ref(&icon);
+    ewmh_icon_r = xcb_get_property_reply(globalconf.connection, ewmh_icon_cookie, NULL);
+    ewmh_client_icon_update(c, ewmh_icon_r);
+    p_delete(&ewmh_icon_r);
 
     /* we honor size hints by default */
     c->honorsizehints = true;
@@ -630,7 +631,7 @@ client_resize(client_t *c, area_t geometry, bool hints)
             screen_client_moveto(c, new_screen, true, false);
 
         /* execute hook */
-        hooks_property(c, "geometry");
+        hooks_property(c, CLIENT_PROPERTY_GEOMETRY);
     }
 }
 
@@ -655,7 +656,7 @@ client_setfloating(client_t *c, bool floating)
                             c->win, _AWESOME_FLOATING, CARDINAL, 8, 1,
                             &c->isfloating);
         /* execute hook */
-        hooks_property(c, "floating");
+        hooks_property(c, CLIENT_PROPERTY_FLOATING);
     }
 }
 
@@ -673,7 +674,7 @@ client_setminimized(client_t *c, bool s)
         client_need_arrange(c);
         ewmh_client_update_hints(c);
         /* execute hook */
-        hooks_property(c, "minimized");
+        hooks_property(c, CLIENT_PROPERTY_MINIMIZED);
     }
 }
 
@@ -690,7 +691,7 @@ client_setsticky(client_t *c, bool s)
         c->issticky = s;
         client_need_arrange(c);
         ewmh_client_update_hints(c);
-        hooks_property(c, "sticky");
+        hooks_property(c, CLIENT_PROPERTY_STICKY);
     }
 }
 
@@ -726,7 +727,7 @@ client_setfullscreen(client_t *c, bool s)
                             c->win, _AWESOME_FULLSCREEN, CARDINAL, 8, 1,
                             &c->isfullscreen);
         ewmh_client_update_hints(c);
-        hooks_property(c, "fullscreen");
+        hooks_property(c, CLIENT_PROPERTY_FULLSCREEN);
     }
 }
 
@@ -743,7 +744,7 @@ client_setabove(client_t *c, bool s)
         client_stack();
         ewmh_client_update_hints(c);
         /* execute hook */
-        hooks_property(c, "above");
+        hooks_property(c, CLIENT_PROPERTY_ABOVE);
     }
 }
 
@@ -760,7 +761,7 @@ client_setbelow(client_t *c, bool s)
         client_stack();
         ewmh_client_update_hints(c);
         /* execute hook */
-        hooks_property(c, "below");
+        hooks_property(c, CLIENT_PROPERTY_BELOW);
     }
 }
 
@@ -777,7 +778,7 @@ client_setmodal(client_t *c, bool s)
         client_stack();
         ewmh_client_update_hints(c);
         /* execute hook */
-        hooks_property(c, "modal");
+        hooks_property(c, CLIENT_PROPERTY_MODAL);
     }
 }
 
@@ -793,7 +794,7 @@ client_setontop(client_t *c, bool s)
         c->isontop = s;
         client_stack();
         /* execute hook */
-        hooks_property(c, "ontop");
+        hooks_property(c, CLIENT_PROPERTY_ONTOP);
     }
 }
 
@@ -830,6 +831,79 @@ client_unban(client_t *c)
     }
 }
 
+/** Property names, in client_property_t bit order. */
+static const char * const client_property_names[] =
+{
+    "geometry", "floating", "minimized", "sticky", "fullscreen", "above",
+    "below", "modal", "ontop", "border_width", "icon", "urgent", "name",
+    "icon_name",
+};
+
+/** Call a property hook for a client.
+ * \param c The client.
+ * \param props The changed properties, as a client_property_t bitset.
+ * \param hook The hook function.
+ */
+static void
+client_property_hook(client_t *c, uint32_t props, luaA_ref hook)
+{
+    lua_State *L = globalconf.L;
+
+    luaA_client_userdata_new(L, c);
+    lua_newtable(L);
+    for(int i = 0; i < countof(client_property_names); i++)
+        if(props & (1 << i))
+        {
+            lua_pushboolean(L, true);
+            lua_setfield(L, -2, client_property_names[i]);
+        }
+    luaA_dofunction(L, hook, 2, 0);
+}
+
+/** Record a client property change for the property hook.
+ * The immediate property hook is called right away. For the other one,
+ * changes are accumulated per client and reported by client_property_flush().
+ * \param c The client.
+ * \param prop The property that changed.
+ */
+void
+client_property_notify(client_t *c, client_property_t prop)
+{
+    if(globalconf.hooks.property_immediate != LUA_REFNIL)
+        client_property_hook(c, prop, globalconf.hooks.property_immediate);
+
+    if(globalconf.hooks.property == LUA_REFNIL)
+        return;
+
+    if(!c->property_dirty)
+        client_array_append(&globalconf.property_pending, client_ref(&c));
+    c->property_dirty |= prop;
+}
+
+/** Call the property hook once for each client with pending changes.
+ * Changes made by the hook itself are reported on the next call.
+ */
+void
+client_property_flush(void)
+{
+    client_array_t pending = globalconf.property_pending;
+
+    client_array_init(&globalconf.property_pending);
+
+    for(int i = 0; i < pending.len; i++)
+    {
+        client_t *c = pending.tab[i];
+        uint32_t props = c->property_dirty;
+
+        c->property_dirty = 0;
+        if(!c->invalid && globalconf.hooks.property != LUA_REFNIL)
+            client_property_hook(c, props, globalconf.hooks.property);
+        client_unref(&c);
+    }
+
+    client_array_wipe(&pending);
+}
+
 /** Unmanage a client.
  * \param c The client.
  */
@@ -858,6 +932,9 @@ client_unmanage(client_t *c)
     if(globalconf.hooks.clients != LUA_REFNIL)
         luaA_dofunction(globalconf.L, globalconf.hooks.clients, 0, 0);
 
+    /* hooks are done with it, forget it in object tables */
+    luaA_otable_purge(globalconf.L, c);
+
     /* The server grab construct avoids race conditions. */
     xcb_grab_server(globalconf.connection);
 
@@ -1035,7 +1112,7 @@ client_setborder(client_t *c, int width)
             globalconf.screens[c->screen].need_arrange = true;
     }
 
-    hooks_property(c, "border_width");
+    hooks_property(c, CLIENT_PROPERTY_BORDER_WIDTH);
 }
 
 /** Kill a client.
@@ -1312,10 +1389,14 @@ luaA_client_newindex(lua_State *L)
       case A_TK_ICON:
         image = luaA_checkudata(L, 3, "image");
         image_unref(&(*c)->icon);
+        p_delete(&(*c)->icon_data);
+        /* the next _NET_WM_ICON is not the one the icon comes from anymore */
+        (*c)->icon_len = 0;
+        (*c)->icon_hash = 0;
         image_ref(image);
         (*c)->icon = *image;
         /* execute hook */
-        hooks_property(*c, "icon");
+        hooks_property(*c, CLIENT_PROPERTY_ICON);
         break;
       case A_TK_OPACITY:
         if(lua_isnil(L, 3))
@@ -1507,7 +1588,7 @@ luaA_client_index(lua_State *L)
         lua_pushboolean(L, (*c)->isfullscreen);
         break;
       case A_TK_ICON:
-        if((*c)->icon)
+        if(client_icon_get(*c))
             luaA_image_userdata_new(L, (*c)->icon);
         else
             return 0;
@@ -29,6 +29,8 @@ static void
 client_delete(client_t **c)
 {
     button_array_wipe(&(*c)->buttons);
+    image_unref(&(*c)->icon);
+    p_delete(&(*c)->icon_data);
     p_delete(&(*c)->icon_path);
     p_delete(&(*c)->name);
     p_delete(c);
@@ -37,6 +39,23 @@ client_delete(client_t **c)
 ARRAY_FUNCS(client_t *, client, DO_NOTHING)
 DO_RCNT(client_t, client, client_delete)
 
+/** Get a client icon, decoding it from its _NET_WM_ICON pixels if needed.
+ * \param c The client.
+ * \return The icon, or NULL if the client has none.
+ */
+static inline image_t *
+client_icon_get(client_t *c)
+{
+    if(!c->icon && c->icon_data)
+    {
+        image_t *icon = image_new_from_argb32(c->icon_width, c->icon_height, c->icon_data);
+        p_delete(&c->icon_data);
+        if(icon)
+            c->icon = image_ref(&icon);
+    }
+    return c->icon;
+}
+
 #define client_need_arrange(c) \
     do { \
         if(!globalconf.screens[(c)->screen].need_arrange \
@@ -64,6 +83,8 @@ void client_setontop(client_t *, bool);
 void client_setfullscreen(client_t *, bool);
 void client_setminimized(client_t *, bool);
 void client_setborder(client_t *, int);
+void client_property_notify(client_t *, client_property_t);
+void client_property_flush(void);
 
 int luaA_client_newindex(lua_State *);
 
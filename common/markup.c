@@ -19,99 +19,193 @@
  *
  */
 
+#include <ctype.h>
+
 #include <glib.h>
 
 #include "common/markup.h"
 
-/** Callback to invoke when the opening tag of an element is seen.
- * Here is just copies element elements we do not care about, and copies
- * values we care.
- * \param context the context of GMarkup
- * \param element_name element name
- * \param attribute_names array of attribute names
- * \param attribute_values array of attribute values
- * \param user_data pointer to user data, here a markup_parser_data_t pointer
- * \param error a GError
+/** Find a string in a memory zone.
+ * \param s The start of the zone.
+ * \param end The end of the zone.
+ * \param needle The string to find.
+ * \return A pointer to the first occurrence of needle, or NULL.
  */
-static void
-markup_parse_start_element(GMarkupParseContext *context __attribute__ ((unused)),
-                           const gchar *element_name,
-                           const gchar **attribute_names,
-                           const gchar **attribute_values,
-                           gpointer user_data,
-                           GError **error __attribute__ ((unused)))
+static const char *
+markup_find(const char *s, const char *end, const char *needle)
 {
-    markup_parser_data_t *p = (markup_parser_data_t *) user_data;
-    int i;
+    ssize_t len = a_strlen(needle);
 
-    for(i = 0; p->elements[i]; i++)
-        if(!a_strcmp(element_name, p->elements[i])) {
-            (*p->on_element)(p, element_name, attribute_names,
-                             attribute_values);
-            return;
-        }
+    for(; end - s >= len; s++)
+        if(*s == *needle && !memcmp(s, needle, len))
+            return s;
+
+    return NULL;
+}
+
+/** Check if a character can be part of an element or attribute name.
+ * \param c The character.
+ * \return True if it is a name character.
+ */
+static inline bool
+markup_isnamechar(int c)
+{
+    return isalnum((unsigned char) c) || c == '_' || c == '-' || c == ':' || c == '.';
+}
 
-    if(a_strcmp(element_name, "markup"))
+/** Append XML text to a buffer, expanding entities and character
+ * references.
+ * \param buf The buffer where to add.
+ * \param s The text.
+ * \param end The end of the text.
+ * \return False if the text contains an invalid entity.
+ */
+static bool
+markup_unescape(buffer_t *buf, const char *s, const char *end)
+{
+    while(s < end)
     {
-        buffer_addf(&p->text, "<%s", element_name);
-        for(i = 0; attribute_names[i]; i++)
+        const char *amp = memchr(s, '&', end - s), *semi;
+        unsigned long c;
+        char *endptr;
+
+        if(!amp)
+        {
+            buffer_add(buf, s, end - s);
+            return true;
+        }
+
+        buffer_add(buf, s, amp - s);
+        s = amp + 1;
+
+        if(!(semi = memchr(s, ';', end - s)))
+            return false;
+
+        switch(semi - s)
         {
-            buffer_addf(&p->text, " %s=\"%s\"", attribute_names[i],
-                        attribute_values[i]);
+          case 2:
+            if(!strncmp(s, "lt", 2))
+                buffer_addc(buf, '<');
+            else if(!strncmp(s, "gt", 2))
+                buffer_addc(buf, '>');
+            else
+                goto charref;
+            break;
+          case 3:
+            if(!strncmp(s, "amp", 3))
+                buffer_addc(buf, '&');
+            else
+                goto charref;
+            break;
+          case 4:
+            if(!strncmp(s, "quot", 4))
+                buffer_addc(buf, '"');
+            else if(!strncmp(s, "apos", 4))
+                buffer_addc(buf, '\'');
+            else
+                goto charref;
+            break;
+          default:
+          charref:
+            if(*s != '#' || semi - s < 2)
+                return false;
+            if(s[1] == 'x')
+                c = strtoul(s + 2, &endptr, 16);
+            else
+                c = strtoul(s + 1, &endptr, 10);
+            if(endptr != semi || !c || c > 0x10FFFF)
+                return false;
+            buffer_grow(buf, 6);
+            buf->len += g_unichar_to_utf8(c, buf->s + buf->len);
+            buf->s[buf->len] = '\0';
+            break;
         }
-        buffer_addc(&p->text, '>');
+
+        s = semi + 1;
     }
+
+    return true;
 }
 
-/** Callback to invoke when the closing tag of an element is seen. Note that
- * this is also called for empty tags like \<empty/\>.
- * Here is just copies element elements we do not care about.
- * \param context the context of GMarkup
- * \param element_name element name
- * \param user_data pointer to user data, here a markup_parser_data_t pointer
- * \param error a GError
+/** Handle the text between two tags.
+ * \param p The markup parser data.
+ * \param scratch A scratch buffer.
+ * \param s The text.
+ * \param end The end of the text.
+ * \return False if the text is invalid.
  */
-static void
-markup_parse_end_element(GMarkupParseContext *context __attribute__ ((unused)),
-                         const gchar *element_name,
-                         gpointer user_data,
-                         GError **error __attribute__ ((unused)))
+static bool
+markup_parse_text(markup_parser_data_t *p, buffer_t *scratch,
+                  const char *s, const char *end)
 {
-    markup_parser_data_t *p = (markup_parser_data_t *) user_data;
-    int i;
+    /* Pango tags are handled by the caller: store the text as is */
+    if(p->on_tag)
+        return markup_unescape(&p->text, s, end);
 
-    for(i = 0; p->elements[i]; i++)
-        if(!a_strcmp(element_name, p->elements[i]))
-            return;
+    scratch->len = 0;
+    if(!markup_unescape(scratch, s, end))
+        return false;
+    buffer_addc(scratch, '\0');
+    buffer_add_xmlescaped(&p->text, scratch->s);
+    return true;
+}
 
-    if(a_strcmp(element_name, "markup"))
-        buffer_addf(&p->text, "</%s>", element_name);
+/** Handle an opening tag.
+ * \param p The markup parser data.
+ * \param elem The element name.
+ * \param names The attributes names, NULL terminated.
+ * \param values The attributes values, NULL terminated.
+ * \return False if the element has been refused.
+ */
+static bool
+markup_parse_start(markup_parser_data_t *p, const char *elem,
+                   const char **names, const char **values)
+{
+    for(int i = 0; p->elements[i]; i++)
+        if(!a_strcmp(elem, p->elements[i]))
+        {
+            if(p->on_element)
+                (*p->on_element)(p, elem, names, values);
+            return true;
+        }
+
+    if(!a_strcmp(elem, "markup"))
+        return true;
+
+    if(p->on_tag)
+        return (*p->on_tag)(p, elem, names, values);
+
+    buffer_addf(&p->text, "<%s", elem);
+    for(; *names; names++, values++)
+    {
+        buffer_addf(&p->text, " %s=\"", *names);
+        buffer_add_xmlescaped(&p->text, *values);
+        buffer_addc(&p->text, '"');
+    }
+    buffer_addc(&p->text, '>');
+
+    return true;
 }
 
-/** Callback to invoke when some text is seen (text is always inside an
- * element). Note that the text of an element may be spread over multiple calls
- * of this function. If the G_MARKUP_TREAT_CDATA_AS_TEXT  flag is set, this
- * function is also called for the content of CDATA marked sections.
- * Here it recopies blindly the text in the text attribute of user_data.
- * \param context the context of GMarkup
- * \param text the text
- * \param text_len the text length
- * \param user_data pointer to user data, here a markup_parser_data_t pointer
- * \param error a GError
+/** Handle a closing tag. Note that this is also called for empty tags like
+ * \<empty/\>.
+ * \param p The markup parser data.
+ * \param elem The element name.
  */
 static void
-markup_parse_text(GMarkupParseContext *context __attribute__ ((unused)),
-                  const gchar *text,
-                  gsize text_len,
-                  gpointer user_data,
-                  GError **error __attribute__ ((unused)))
+markup_parse_end(markup_parser_data_t *p, const char *elem)
 {
-    markup_parser_data_t *p = (markup_parser_data_t *) user_data;
+    for(int i = 0; p->elements[i]; i++)
+        if(!a_strcmp(elem, p->elements[i]))
+            return;
 
-    if (text_len) {
-        buffer_grow(&p->text, text_len);
-        buffer_add_xmlescaped(&p->text, text);
-    }
+    if(!a_strcmp(elem, "markup"))
+        return;
+
+    if(p->on_tag_end)
+        (*p->on_tag_end)(p, elem);
+    else
+        buffer_addf(&p->text, "</%s>", elem);
 }
 
 /** Create a markup_parser_data_t structure with elements list.
@@ -133,48 +227,211 @@ markup_parser_data_wipe(markup_parser_data_t *p)
 }
 
 /** Parse markup defined in data on the string str.
- * \param data A markup_parser_data_t allocated by markup_parser_data_new().
- * \param str A string to parse markup from.
- * \param slen String length.
- * \return True if success, false otherwise.
+ * The text is parsed in a single pass: elements listed in data are handed
+ * to the on_element callback, other tags are either handed to the on_tag
+ * callbacks or copied back in the text buffer.
+ * \param data A markup_parser_data_t allocated by markup_parser_data_new()
+ * \param str A string to parse markup from
+ * \param slen str length
+ * \return true if success, false otherwise
  */
 bool
 markup_parse(markup_parser_data_t *data, const char *str, ssize_t slen)
 {
-    static GMarkupParser const parser =
+    struct
     {
-        /* start_element */
-        markup_parse_start_element,
-        /* end_element */
-        markup_parse_end_element,
-        /* text */
-        markup_parse_text,
-        /* passthrough */
-        NULL,
-        /* error */
-        NULL
-    };
-    GMarkupParseContext *mkp_ctx;
-    GError *error = NULL;
+        const char *name;
+        int len;
+    } stack[MARKUP_DEPTH_MAX];
+    const char *names[MARKUP_ATTR_MAX + 1], *values[MARKUP_ATTR_MAX + 1];
+    int offs[MARKUP_ATTR_MAX * 2], depth = 0, nattrs, i;
+    const char *s = str, *end = str + slen, *error = NULL;
+    buffer_t scratch;
+
+    data->aborted = false;
 
     if(slen <= 0)
         return false;
 
-    mkp_ctx = g_markup_parse_context_new(&parser, 0, data, NULL);
+    buffer_init(&scratch);
 
-    if(!g_markup_parse_context_parse(mkp_ctx, "<markup>", -1, &error)
-       || !g_markup_parse_context_parse(mkp_ctx, str, slen, &error)
-       || !g_markup_parse_context_parse(mkp_ctx, "</markup>", -1, &error)
-       || !g_markup_parse_context_end_parse(mkp_ctx, &error))
+    while(s < end)
     {
-        warn("unable to parse text \"%s\": %s", str, error ? error->message : "unknown error");
-        if(error)
-            g_error_free(error);
-        g_markup_parse_context_free(mkp_ctx);
-        return false;
+        const char *lt = memchr(s, '<', end - s), *name, *close;
+        int nlen;
+        bool empty = false;
+
+        if(!markup_parse_text(data, &scratch, s, lt ? lt : end))
+        {
+            error = "invalid entity";
+            goto bailout;
+        }
+
+        if(!lt)
+            break;
+
+        s = lt + 1;
+
+        /* comments, CDATA and processing instructions are ignored */
+        if(s < end && (*s == '!' || *s == '?'))
+        {
+            if(end - s >= 3 && !strncmp(s, "!--", 3))
+                close = markup_find(s + 3, end, "-->");
+            else if(end - s >= 8 && !strncmp(s, "![CDATA[", 8))
+                close = markup_find(s + 8, end, "]]>");
+            else if(*s == '?')
+                close = markup_find(s + 1, end, "?>");
+            else
+            {
+                error = "unsupported declaration";
+                goto bailout;
+            }
+            if(!close)
+            {
+                error = "unterminated comment or declaration";
+                goto bailout;
+            }
+            s = close + (*close == '?' ? 2 : 3);
+            continue;
+        }
+
+        /* closing tag */
+        if(s < end && *s == '/')
+        {
+            for(name = ++s; s < end && markup_isnamechar(*s); s++);
+            nlen = s - name;
+            for(; s < end && isspace((unsigned char) *s); s++);
+            if(s >= end || *s != '>')
+            {
+                error = "malformed closing tag";
+                goto bailout;
+            }
+            s++;
+            if(!depth
+               || stack[depth - 1].len != nlen
+               || memcmp(stack[depth - 1].name, name, nlen))
+            {
+                error = "unexpected closing tag";
+                goto bailout;
+            }
+            depth--;
+            scratch.len = 0;
+            buffer_add(&scratch, name, nlen);
+            buffer_addc(&scratch, '\0');
+            markup_parse_end(data, scratch.s);
+            continue;
+        }
+
+        /* opening tag */
+        for(name = s; s < end && markup_isnamechar(*s); s++);
+        if(!(nlen = s - name))
+        {
+            error = "invalid element name";
+            goto bailout;
+        }
+
+        scratch.len = 0;
+        buffer_add(&scratch, name, nlen);
+        buffer_addc(&scratch, '\0');
+
+        for(nattrs = 0;; nattrs++)
+        {
+            const char *aname, *value;
+            int alen;
+
+            for(; s < end && isspace((unsigned char) *s); s++);
+            if(s >= end)
+            {
+                error = "unterminated tag";
+                goto bailout;
+            }
+            if(*s == '>')
+            {
+                s++;
+                break;
+            }
+            if(*s == '/' && s + 1 < end && s[1] == '>')
+            {
+                s += 2;
+                empty = true;
+                break;
+            }
+
+            for(aname = s; s < end && markup_isnamechar(*s); s++);
+            alen = s - aname;
+            for(; s < end && isspace((unsigned char) *s); s++);
+            if(!alen || s >= end || *s != '=')
+            {
+                error = "invalid attribute";
+                goto bailout;
+            }
+            for(s++; s < end && isspace((unsigned char) *s); s++);
+            if(s >= end || (*s != '"' && *s != '\'')
+               || !(value = memchr(s + 1, *s, end - s - 1)))
+            {
+                error = "unquoted or unterminated attribute value";
+                goto bailout;
+            }
+            if(nattrs == MARKUP_ATTR_MAX)
+            {
+                error = "too many attributes";
+                goto bailout;
+            }
+
+            offs[nattrs * 2] = scratch.len;
+            buffer_add(&scratch, aname, alen);
+            buffer_addc(&scratch, '\0');
+            offs[nattrs * 2 + 1] = scratch.len;
+            if(!markup_unescape(&scratch, s + 1, value))
+            {
+                error = "invalid entity";
+                goto bailout;
+            }
+            buffer_addc(&scratch, '\0');
+            s = value + 1;
+        }
+
+        for(i = 0; i < nattrs; i++)
+        {
+            names[i] = scratch.s + offs[i * 2];
+            values[i] = scratch.s + offs[i * 2 + 1];
+        }
+        names[nattrs] = values[nattrs] = NULL;
+
+        if(!empty)
+        {
+            if(depth == MARKUP_DEPTH_MAX)
+            {
+                error = "elements too deeply nested";
+                goto bailout;
+            }
+            stack[depth].name = name;
+            stack[depth].len = nlen;
+            depth++;
+        }
+
+        if(!markup_parse_start(data, scratch.s, names, values))
+        {
+            data->aborted = true;
+            buffer_wipe(&scratch);
+            return false;
+        }
+
+        if(empty)
+            markup_parse_end(data, scratch.s);
     }
 
-    g_markup_parse_context_free(mkp_ctx);
+    if(depth)
+        error = "unclosed element";
+
+  bailout:
+    buffer_wipe(&scratch);
+
+    if(error)
+    {
+        warn("unable to parse text \"%.*s\": %s", (int) slen, str, error);
+        return false;
+    }
 
     return true;
 }
@@ -24,16 +24,30 @@
 
 #include "common/buffer.h"
 
+/** Maximum nesting depth of elements */
+#define MARKUP_DEPTH_MAX 32
+/** Maximum number of attributes of an element */
+#define MARKUP_ATTR_MAX 32
+
 typedef struct markup_parser_data_t markup_parser_data_t;
 
 typedef void (markup_on_elem_f)(markup_parser_data_t *, const char *,
                                 const char **, const char **);
+typedef bool (markup_on_tag_f)(markup_parser_data_t *, const char *,
+                               const char **, const char **);
+typedef void (markup_on_tag_end_f)(markup_parser_data_t *, const char *);
 
 struct markup_parser_data_t
 {
     buffer_t text;
     const char * const *elements;
     markup_on_elem_f *on_element;
+    /** Optional callbacks for the other tags. If set, the tags are not
+     * copied back to text and the text is stored unescaped. Returning false
+     * from on_tag aborts the parsing and sets aborted. */
+    markup_on_tag_f *on_tag;
+    markup_on_tag_end_f *on_tag_end;
+    bool aborted;
     void *priv;
 };
 
@@ -0,0 +1,158 @@
+/*
+ * premultiply.c - ARGB32 premultiplication
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "common/premultiply.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PREMULTIPLY_X86
+
+#include <immintrin.h>
+
+/** Premultiply 2 pixels unpacked to 16 bits per component.
+ * The alpha component is multiplied by 255 so it stays unchanged.
+ * \param x The pixels.
+ * \return The premultiplied pixels.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+premultiply_sse2_unpacked(__m128i x)
+{
+    const __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)),
+                                    _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(_mm_or_si128(x, alpha_one), a),
+                              _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/** Premultiply pixels 4 by 4 with SSE2.
+ * \param dst The destination pixels.
+ * \param src The source pixels.
+ * \param size The number of pixels.
+ * \return The number of pixels done.
+ */
+__attribute__((target("sse2")))
+static int
+premultiply_sse2(uint32_t *dst, const uint32_t *src, int size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i;
+
+    for(i = 0; i + 4 <= size; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i lo = premultiply_sse2_unpacked(_mm_unpacklo_epi8(p, zero));
+        __m128i hi = premultiply_sse2_unpacked(_mm_unpackhi_epi8(p, zero));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+
+/** Premultiply 4 pixels unpacked to 16 bits per component.
+ * \param x The pixels.
+ * \return The premultiplied pixels.
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+premultiply_avx2_unpacked(__m256i x)
+{
+    const __m256i alpha_one = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0,
+                                               255, 0, 0, 0, 255, 0, 0, 0);
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)),
+                                       _MM_SHUFFLE(3, 3, 3, 3));
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_or_si256(x, alpha_one), a),
+                                 _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+/** Premultiply pixels 8 by 8 with AVX2. Unpacking and packing both work
+ * inside 128 bits lanes, so pixels keep their order.
+ * \param dst The destination pixels.
+ * \param src The source pixels.
+ * \param size The number of pixels.
+ * \return The number of pixels done.
+ */
+__attribute__((target("avx2")))
+static int
+premultiply_avx2(uint32_t *dst, const uint32_t *src, int size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i;
+
+    for(i = 0; i + 8 <= size; i += 8)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i lo = premultiply_avx2_unpacked(_mm256_unpacklo_epi8(p, zero));
+        __m256i hi = premultiply_avx2_unpacked(_mm256_unpackhi_epi8(p, zero));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+#endif
+
+/** Get the vector kernels supported by the CPU.
+ * \param len Set to the number of kernels.
+ * \return The kernels, fastest first.
+ */
+const premultiply_kernel_t *
+premultiply_kernels(int *len)
+{
+    static premultiply_kernel_t kernels[2];
+    static int kernels_len = -1;
+
+    if(kernels_len < 0)
+    {
+        kernels_len = 0;
+#ifdef PREMULTIPLY_X86
+        if(__builtin_cpu_supports("avx2"))
+            kernels[kernels_len++] = (premultiply_kernel_t) { "avx2", premultiply_avx2 };
+        if(__builtin_cpu_supports("sse2"))
+            kernels[kernels_len++] = (premultiply_kernel_t) { "sse2", premultiply_sse2 };
+#endif
+    }
+
+    *len = kernels_len;
+    return kernels;
+}
+
+/** Premultiply ARGB32 pixels by their alpha, as cairo wants them.
+ * All kernels give the very same result.
+ * \param dst The destination pixels.
+ * \param src The source pixels.
+ * \param size The number of pixels.
+ */
+void
+premultiply(uint32_t *dst, const uint32_t *src, int size)
+{
+    const premultiply_kernel_t *kernels;
+    int i = 0, len;
+
+    kernels = premultiply_kernels(&len);
+    if(len)
+        i = kernels[0].run(dst, src, size);
+
+    for(; i < size; i++)
+        dst[i] = premultiply_pixel(src[i]);
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
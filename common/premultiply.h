@@ -0,0 +1,69 @@
+/*
+ * premultiply.h - ARGB32 premultiplication header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_COMMON_PREMULTIPLY_H
+#define AWESOME_COMMON_PREMULTIPLY_H
+
+#include <stdint.h>
+
+/** A vector premultiplication kernel */
+typedef struct
+{
+    /** Instruction set name */
+    const char *name;
+    /** Premultiply pixels, as many as the vector size allows, and return
+     * their number */
+    int (*run)(uint32_t *, const uint32_t *, int);
+} premultiply_kernel_t;
+
+/** Multiply a color component by an alpha value, rounded the same way as
+ * the vector kernels do.
+ * \param c The color component.
+ * \param a The alpha value.
+ * \return c * a / 255, rounded.
+ */
+static inline uint32_t
+premultiply_mul_div255(uint32_t c, uint32_t a)
+{
+    uint32_t t = c * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+/** Premultiply an ARGB32 pixel by its alpha.
+ * \param p The pixel.
+ * \return The premultiplied pixel.
+ */
+static inline uint32_t
+premultiply_pixel(uint32_t p)
+{
+    uint32_t a = p >> 24;
+
+    return (a << 24)
+        | (premultiply_mul_div255((p >> 16) & 0xff, a) << 16)
+        | (premultiply_mul_div255((p >> 8) & 0xff, a) << 8)
+        | premultiply_mul_div255(p & 0xff, a);
+}
+
+const premultiply_kernel_t *premultiply_kernels(int *);
+void premultiply(uint32_t *, const uint32_t *, int);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <stdio.h>
@@ -274,6 +275,48 @@ static inline int a_strncmp(const char *a, const char *b, ssize_t n)
     return strncmp(NONULL(a), NONULL(b), n);
 }
 
+/** \brief compute a hash of a memory zone.
+ *
+ * This is the FNV-1a hash function: it is fast, simple and good enough to
+ * be used as a cache key.
+ *
+ * \param[in]  data  the data to hash.
+ * \param[in]  len   the data length.
+ * \return the hash value.
+ */
+static inline uint32_t
+a_memhash(const void *data, ssize_t len)
+{
+    const unsigned char *p = data;
+    uint32_t hash = 2166136261U;
+
+    for(ssize_t i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * 16777619U;
+
+    return hash;
+}
+
+/** \brief compute a 64 bits hash of a memory zone.
+ *
+ * This is the 64 bits FNV-1a hash function, for when collisions would not
+ * just cost a cache miss.
+ *
+ * \param[in]  data  the data to hash.
+ * \param[in]  len   the data length.
+ * \return the hash value.
+ */
+static inline uint64_t
+a_memhash64(const void *data, ssize_t len)
+{
+    const unsigned char *p = data;
+    uint64_t hash = 14695981039346656037ULL;
+
+    for(ssize_t i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+
+    return hash;
+}
+
 ssize_t a_strncpy(char *dst, ssize_t n, const char *src, ssize_t l) __attribute__((nonnull(1)));
 ssize_t a_strcpy(char *dst, ssize_t n, const char *src) __attribute__((nonnull(1)));
 
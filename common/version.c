@@ -52,6 +52,12 @@ eprint_version(const char *const executable)
     printf("✔\n");
 #else
     printf("✘\n");
+#endif
+    printf(" • Background JPEG decoding: ");
+#ifdef WITH_JPEG
+    printf("✔\n");
+#else
+    printf("✘\n");
 #endif
     exit(EXIT_SUCCESS);
 }
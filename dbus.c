@@ -30,6 +30,7 @@
 #include "dbus.h"
 #include "widget.h"
 #include "client.h"
+#include "profile.h"
 
 extern awesome_t globalconf;
 
@@ -89,6 +90,56 @@ bailout:
     p_delete(&path);
 }
 
+/** Control the Lua profiler.
+ * The first argument is `start', `stop' or `dump'. `start' takes the number
+ * of seconds between two samples as an optional second argument, and `dump'
+ * replies with the samples as folded stacks.
+ * \param msg The method call.
+ */
+static void
+a_dbus_process_request_profile(DBusMessage *msg)
+{
+    DBusMessageIter iter;
+    DBusMessage *reply;
+    buffer_t buf;
+    char *action;
+    double interval = PROFILE_INTERVAL;
+
+    if(!dbus_message_iter_init(msg, &iter)
+       || DBUS_TYPE_STRING != dbus_message_iter_get_arg_type(&iter))
+        return;
+
+    dbus_message_iter_get_basic(&iter, &action);
+
+    buffer_init(&buf);
+
+    if(!a_strcmp(action, "start"))
+    {
+        if(dbus_message_iter_next(&iter)
+           && DBUS_TYPE_DOUBLE == dbus_message_iter_get_arg_type(&iter))
+            dbus_message_iter_get_basic(&iter, &interval);
+        profile_start(globalconf.L, interval);
+    }
+    else if(!a_strcmp(action, "stop"))
+        profile_stop();
+    else if(!a_strcmp(action, "dump"))
+        profile_dump(globalconf.L, &buf);
+    else
+        warn("unknown profiler action: %s", action);
+
+    if(!dbus_message_get_no_reply(msg)
+       && (reply = dbus_message_new_method_return(msg)))
+    {
+        const char *text = buf.s;
+
+        dbus_message_append_args(reply, DBUS_TYPE_STRING, &text, DBUS_TYPE_INVALID);
+        dbus_connection_send(dbus_connection, reply, NULL);
+        dbus_message_unref(reply);
+    }
+
+    buffer_wipe(&buf);
+}
+
 static void
 a_dbus_process_requests(EV_P_ ev_io *w, int revents)
 {
@@ -113,6 +164,8 @@ a_dbus_process_requests(EV_P_ ev_io *w, int revents)
         }
         else if(dbus_message_is_method_call(msg, "org.awesome", "do"))
             a_dbus_process_request_do(msg);
+        else if(dbus_message_is_method_call(msg, "org.awesome", "profile"))
+            a_dbus_process_request_profile(msg);
 
         dbus_message_unref(msg);
 
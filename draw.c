@@ -27,6 +27,7 @@
 #include <iconv.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
 #include <math.h>
 
 #include "structs.h"
@@ -151,11 +152,41 @@ draw_font_delete(font_t **font)
     }
 }
 
+static void
+draw_pango_attr_delete(PangoAttribute **attr)
+{
+    pango_attribute_destroy(*attr);
+}
+
+DO_ARRAY(PangoAttribute *, pango_attr, draw_pango_attr_delete)
+
+/** State of the markup parser while expanding a text. */
+typedef struct
+{
+    /** The parser data being filled */
+    draw_parser_data_t *data;
+    /** Opened Pango tags */
+    struct
+    {
+        /** Where the tag text starts */
+        int start;
+        /** Number of attributes the tag pushed in opened */
+        int nattrs;
+        /** Font scale inside the tag */
+        double scale;
+    } stack[MARKUP_DEPTH_MAX];
+    int depth;
+    /** Attributes of the opened tags */
+    pango_attr_array_t opened;
+    /** Attributes of the closed tags, in closing order */
+    pango_attr_array_t closed;
+} draw_markup_state_t;
+
 static void
 draw_markup_on_element(markup_parser_data_t *p, const char *elem,
                        const char **names, const char **values)
 {
-    draw_parser_data_t *data = p->priv;
+    draw_parser_data_t *data = ((draw_markup_state_t *) p->priv)->data;
 
     xcolor_init_request_t reqs[3];
     int8_t i, bg_color_nbr = -1, reqs_nbr = -1;
@@ -190,8 +221,9 @@ draw_markup_on_element(markup_parser_data_t *p, const char *elem,
                         break;
                       case A_TK_IMAGE:
                         if(data->bg_image)
-                            image_delete(&data->bg_image);
-                        data->bg_image = image_new_from_file(*values);
+                            image_unref(&data->bg_image);
+                        if((data->bg_image = image_new_from_file(*values)))
+                            image_ref(&data->bg_image);
                         break;
                       case A_TK_ALIGN:
                         data->bg_align = draw_align_fromstr(*values, -1);
@@ -263,41 +295,531 @@ draw_markup_on_element(markup_parser_data_t *p, const char *elem,
             xcolor_init_reply(reqs[i]);
 }
 
+/** Transform a string to a Pango underline type.
+ * \param underline The string.
+ * \param u The underline type to fill.
+ * \return False if the string is not recognized.
+ */
+static bool
+draw_underline_fromstr(const char *underline, PangoUnderline *u)
+{
+    if(!a_strcmp(underline, "none") || !a_strcmp(underline, "false"))
+        *u = PANGO_UNDERLINE_NONE;
+    else if(!a_strcmp(underline, "single") || !a_strcmp(underline, "true"))
+        *u = PANGO_UNDERLINE_SINGLE;
+    else if(!a_strcmp(underline, "double"))
+        *u = PANGO_UNDERLINE_DOUBLE;
+    else if(!a_strcmp(underline, "low"))
+        *u = PANGO_UNDERLINE_LOW;
+    else if(!a_strcmp(underline, "error"))
+        *u = PANGO_UNDERLINE_ERROR;
+    else
+        return false;
+    return true;
+}
+
+/** Parse an integer markup attribute value.
+ * \param value The value.
+ * \param n The integer to fill.
+ * \return False if the value is not a plain integer.
+ */
+static bool
+draw_int_fromstr(const char *value, int *n)
+{
+    char *end;
+    long l;
+
+    errno = 0;
+    l = strtol(value, &end, 10);
+    if(end == value || *end || errno || l < INT_MIN || l > INT_MAX)
+        return false;
+    *n = l;
+    return true;
+}
+
+/** Parse a Pango font size, in thousandths of a point, or in points with a
+ * pt unit.
+ * \param value The value.
+ * \param size The size to fill, in Pango units.
+ * \return False if the value is not a size, or has another unit.
+ */
+static bool
+draw_fontsize_fromstr(const char *value, int *size)
+{
+    char *end;
+    double points;
+
+    if(draw_int_fromstr(value, size))
+        return *size >= 0;
+
+    errno = 0;
+    points = strtod(value, &end);
+    if(end == value || errno || a_strcmp(end, "pt")
+       || points < 0 || points > INT_MAX / PANGO_SCALE)
+        return false;
+    *size = points * PANGO_SCALE;
+    return true;
+}
+
+/** Transform a Pango size keyword to a font scale.
+ * \param size The size keyword.
+ * \param parent The parent font scale.
+ * \param scale The scale to fill.
+ * \return False if the keyword is not recognized.
+ */
+static bool
+draw_size_fromstr(const char *size, double parent, double *scale)
+{
+    static const char * const sizes[] =
+    {
+        "xx-small", "x-small", "small", "medium", "large", "x-large", "xx-large"
+    };
+
+    if(!a_strcmp(size, "smaller"))
+        *scale = parent / PANGO_SCALE_LARGE;
+    else if(!a_strcmp(size, "larger"))
+        *scale = parent * PANGO_SCALE_LARGE;
+    else
+    {
+        for(int i = 0; i < countof(sizes); i++)
+            if(!a_strcmp(size, sizes[i]))
+            {
+                *scale = pow(PANGO_SCALE_LARGE, i - 3);
+                return true;
+            }
+        return false;
+    }
+    return true;
+}
+
+/** Build the Pango attributes of a span tag.
+ * \param state The markup parser state.
+ * \param names The attributes names.
+ * \param values The attributes values.
+ * \return False if an attribute is not supported.
+ */
+static bool
+draw_markup_span(draw_markup_state_t *state, const char **names, const char **values)
+{
+    double *scale = &state->stack[state->depth].scale;
+    PangoFontDescription *desc;
+    PangoColor color;
+    PangoStyle style;
+    PangoWeight weight;
+    PangoVariant variant;
+    PangoStretch stretch;
+    PangoUnderline underline;
+    int n;
+
+    for(; *names; names++, values++)
+        switch(a_tokenize(*names, -1))
+        {
+          case A_TK_FONT:
+          case A_TK_FONT_DESC:
+            desc = pango_font_description_from_string(*values);
+            pango_attr_array_append(&state->opened, pango_attr_font_desc_new(desc));
+            pango_font_description_free(desc);
+            break;
+          case A_TK_FACE:
+          case A_TK_FONT_FAMILY:
+            pango_attr_array_append(&state->opened, pango_attr_family_new(*values));
+            break;
+          case A_TK_SIZE:
+            /* other units are left to Pango */
+            if(isdigit((unsigned char) **values))
+            {
+                if(!draw_fontsize_fromstr(*values, &n))
+                    return false;
+                pango_attr_array_append(&state->opened, pango_attr_size_new(n));
+            }
+            else if(draw_size_fromstr(*values, *scale, scale))
+                pango_attr_array_append(&state->opened, pango_attr_scale_new(*scale));
+            else
+                return false;
+            break;
+          case A_TK_STYLE:
+            if(!pango_parse_style(*values, &style, false))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_style_new(style));
+            break;
+          case A_TK_WEIGHT:
+            if(!pango_parse_weight(*values, &weight, false))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_weight_new(weight));
+            break;
+          case A_TK_VARIANT:
+            if(!pango_parse_variant(*values, &variant, false))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_variant_new(variant));
+            break;
+          case A_TK_STRETCH:
+            if(!pango_parse_stretch(*values, &stretch, false))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_stretch_new(stretch));
+            break;
+          case A_TK_COLOR:
+          case A_TK_FGCOLOR:
+          case A_TK_FOREGROUND:
+            if(!pango_color_parse(&color, *values))
+                return false;
+            pango_attr_array_append(&state->opened,
+                                    pango_attr_foreground_new(color.red, color.green, color.blue));
+            break;
+          case A_TK_BGCOLOR:
+          case A_TK_BACKGROUND:
+            if(!pango_color_parse(&color, *values))
+                return false;
+            pango_attr_array_append(&state->opened,
+                                    pango_attr_background_new(color.red, color.green, color.blue));
+            break;
+          case A_TK_UNDERLINE:
+            if(!draw_underline_fromstr(*values, &underline))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_underline_new(underline));
+            break;
+          case A_TK_STRIKETHROUGH:
+            pango_attr_array_append(&state->opened,
+                                    pango_attr_strikethrough_new(a_strtobool(*values, -1)));
+            break;
+          case A_TK_RISE:
+            if(!draw_int_fromstr(*values, &n))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_rise_new(n));
+            break;
+          case A_TK_LETTER_SPACING:
+            if(!draw_int_fromstr(*values, &n))
+                return false;
+            pango_attr_array_append(&state->opened, pango_attr_letter_spacing_new(n));
+            break;
+          case A_TK_LANG:
+            pango_attr_array_append(&state->opened,
+                                    pango_attr_language_new(pango_language_from_string(*values)));
+            break;
+          default:
+            return false;
+        }
+
+    return true;
+}
+
+/** Handle a Pango tag by building its attributes.
+ * \param p The markup parser data.
+ * \param elem The element name.
+ * \param names The attributes names.
+ * \param values The attributes values.
+ * \return False if the tag is not supported, so Pango has to parse it.
+ */
+static bool
+draw_markup_on_tag(markup_parser_data_t *p, const char *elem,
+                   const char **names, const char **values)
+{
+    draw_markup_state_t *state = p->priv;
+    pango_attr_array_t *opened = &state->opened;
+    double *scale = &state->stack[state->depth].scale;
+    int nattrs = opened->len;
+    bool ret = true;
+
+    *scale = state->depth ? state->stack[state->depth - 1].scale : 1.0;
+
+    if(!a_strcmp(elem, "span"))
+        ret = draw_markup_span(state, names, values);
+    else if(*names)
+        /* only span has attributes */
+        ret = false;
+    else if(!a_strcmp(elem, "b"))
+        pango_attr_array_append(opened, pango_attr_weight_new(PANGO_WEIGHT_BOLD));
+    else if(!a_strcmp(elem, "i"))
+        pango_attr_array_append(opened, pango_attr_style_new(PANGO_STYLE_ITALIC));
+    else if(!a_strcmp(elem, "s"))
+        pango_attr_array_append(opened, pango_attr_strikethrough_new(true));
+    else if(!a_strcmp(elem, "u"))
+        pango_attr_array_append(opened, pango_attr_underline_new(PANGO_UNDERLINE_SINGLE));
+    else if(!a_strcmp(elem, "tt"))
+        pango_attr_array_append(opened, pango_attr_family_new("Monospace"));
+    else if(!a_strcmp(elem, "big"))
+        pango_attr_array_append(opened, pango_attr_scale_new(*scale *= PANGO_SCALE_LARGE));
+    else if(!a_strcmp(elem, "small"))
+        pango_attr_array_append(opened, pango_attr_scale_new(*scale /= PANGO_SCALE_LARGE));
+    else if(!a_strcmp(elem, "sub") || !a_strcmp(elem, "sup"))
+    {
+        pango_attr_array_append(opened, pango_attr_rise_new(elem[2] == 'b' ? -5000 : 5000));
+        pango_attr_array_append(opened, pango_attr_scale_new(*scale /= PANGO_SCALE_LARGE));
+    }
+    else
+        ret = false;
+
+    if(!ret)
+    {
+        while(opened->len > nattrs)
+        {
+            PangoAttribute *attr = pango_attr_array_take(opened, opened->len - 1);
+            draw_pango_attr_delete(&attr);
+        }
+        return false;
+    }
+
+    state->stack[state->depth].start = p->text.len;
+    state->stack[state->depth].nattrs = opened->len - nattrs;
+    state->depth++;
+
+    return true;
+}
+
+/** Handle the end of a Pango tag: its attributes now know where they end.
+ * \param p The markup parser data.
+ * \param elem The element name.
+ */
+static void
+draw_markup_on_tag_end(markup_parser_data_t *p,
+                       const char *elem __attribute__ ((unused)))
+{
+    draw_markup_state_t *state = p->priv;
+
+    state->depth--;
+
+    for(int i = 0; i < state->stack[state->depth].nattrs; i++)
+    {
+        PangoAttribute *attr = pango_attr_array_take(&state->opened, state->opened.len - 1);
+        attr->start_index = state->stack[state->depth].start;
+        attr->end_index = p->text.len;
+        pango_attr_array_append(&state->closed, attr);
+    }
+}
+
+/** Expand the markup of a text into parser data.
+ * Awesome elements and Pango tags are handled in a single pass, building
+ * the Pango attributes list directly. Pango is only asked to parse the
+ * markup if it uses something we do not know.
+ * \param data The parser data to fill.
+ * \param str The text.
+ * \param slen The text length.
+ * \return True if the markup is valid.
+ */
 static bool
 draw_text_markup_expand(draw_parser_data_t *data,
                         const char *str, ssize_t slen)
 {
     static char const * const elements[] = { "bg", "bg_margin", "text", "margin", "border", NULL };
+    draw_markup_state_t state = { .data = data };
     markup_parser_data_t p =
     {
         .elements   = elements,
-        .priv       = data,
+        .priv       = &state,
         .on_element = &draw_markup_on_element,
+        .on_tag     = &draw_markup_on_tag,
+        .on_tag_end = &draw_markup_on_tag_end,
     };
     GError *error = NULL;
     bool ret = false;
 
-    markup_parser_data_init(&p);
+    if(slen <= 0)
+        return false;
+
+    /* No markup at all: the text is used as is. */
+    if(!memchr(str, '<', slen) && !memchr(str, '&', slen)
+       && g_utf8_validate(str, slen, NULL))
+    {
+        data->text = p_new(char, slen + 1);
+        memcpy(data->text, str, slen);
+        data->len = slen;
+        return true;
+    }
 
-    if(!markup_parse(&p, str, slen))
-        goto bailout;
+    markup_parser_data_init(&p);
 
-    if(!pango_parse_markup(p.text.s, p.text.len, 0, &data->attr_list, &data->text, NULL, &error))
+    if(markup_parse(&p, str, slen))
     {
-        warn("cannot parse pango markup: %s", error ? error->message : "unknown error");
-        if(error)
-            g_error_free(error);
-        goto bailout;
+        if(!g_utf8_validate(p.text.s, p.text.len, NULL))
+        {
+            warn("cannot parse text \"%.*s\": invalid UTF-8", (int) slen, str);
+            goto bailout;
+        }
+
+        data->attr_list = pango_attr_list_new();
+        /* inner tags must override outer ones */
+        while(state.closed.len)
+            pango_attr_list_insert(data->attr_list,
+                                   pango_attr_array_take(&state.closed, state.closed.len - 1));
+        data->len = p.text.len;
+        data->text = buffer_detach(&p.text);
+        ret = true;
     }
+    else if(p.aborted)
+    {
+        /* Unknown Pango markup: start again and let Pango parse it. */
+        draw_parser_data_wipe(data);
+        draw_parser_data_init(data);
+        markup_parser_data_wipe(&p);
+        markup_parser_data_init(&p);
+        p.on_tag = NULL;
+        p.on_tag_end = NULL;
+
+        if(!markup_parse(&p, str, slen))
+            goto bailout;
+
+        if(!pango_parse_markup(p.text.s, p.text.len, 0, &data->attr_list, &data->text, NULL, &error))
+        {
+            warn("cannot parse pango markup: %s", error ? error->message : "unknown error");
+            if(error)
+                g_error_free(error);
+            goto bailout;
+        }
 
-    data->len = a_strlen(data->text);
-    ret = true;
+        data->len = a_strlen(data->text);
+        ret = true;
+    }
 
   bailout:
+    pango_attr_array_wipe(&state.opened);
+    pango_attr_array_wipe(&state.closed);
     markup_parser_data_wipe(&p);
     return ret;
 }
 
+typedef struct draw_text_cache_entry_t draw_text_cache_entry_t;
+/** A parsed and measured text, as kept in the text cache. */
+struct draw_text_cache_entry_t
+{
+    /** Font used to render the text */
+    PangoFontDescription *font;
+    /** The raw markup */
+    char *markup;
+    ssize_t len;
+    /** Layout width and height, -1 if unconstrained */
+    int width, height;
+    /** Ellipsize and wrap mode */
+    PangoEllipsizeMode ellip;
+    PangoWrapMode wrap;
+    /** Hash of the markup and the font */
+    uint32_t hash;
+    /** The parsed markup */
+    draw_parser_data_t pdata;
+    /** Pixel extents of the text, if already computed */
+    bool has_extents;
+    PangoRectangle extents;
+    /** Next and previous entries, most recently used first */
+    draw_text_cache_entry_t *prev, *next;
+};
+
+static void
+draw_text_cache_entry_delete(draw_text_cache_entry_t **entry)
+{
+    if((*entry)->font)
+        pango_font_description_free((*entry)->font);
+    p_delete(&(*entry)->markup);
+    draw_parser_data_wipe(&(*entry)->pdata);
+    p_delete(entry);
+}
+
+DO_SLIST(draw_text_cache_entry_t, draw_text_cache_entry, draw_text_cache_entry_delete)
+
+/** The text cache, shared by every text drawing function. */
+static struct
+{
+    /** Entries, most recently used first */
+    draw_text_cache_entry_t *entries;
+    /** Number of entries */
+    int len;
+    /** Statistics */
+    unsigned int hits, misses;
+} draw_text_cache;
+
+/** Get a parsed text from the text cache, parsing it if needed.
+ * \param font The font to use.
+ * \param text The markup text.
+ * \param len The markup text length.
+ * \param width The layout width, -1 if unconstrained.
+ * \param height The layout height, -1 if unconstrained.
+ * \param ellip Ellipsize mode.
+ * \param wrap Wrap mode.
+ * \return A cache entry. If the markup cannot be parsed, the entry holds the
+ * raw text, so that it is drawn as is and not parsed again.
+ */
+static draw_text_cache_entry_t *
+draw_text_cache_get(font_t *font, const char *text, ssize_t len,
+                    int width, int height,
+                    PangoEllipsizeMode ellip, PangoWrapMode wrap)
+{
+    draw_text_cache_entry_t *entry;
+    uint32_t hash;
+
+    if(len < 0)
+        len = a_strlen(text);
+
+    hash = a_memhash(text, len) ^ pango_font_description_hash(font->desc);
+
+    for(entry = draw_text_cache.entries; entry; entry = entry->next)
+        if(entry->hash == hash
+           && entry->len == len
+           && entry->width == width
+           && entry->height == height
+           && entry->ellip == ellip
+           && entry->wrap == wrap
+           && !memcmp(entry->markup, text, len)
+           && pango_font_description_equal(entry->font, font->desc))
+        {
+            draw_text_cache.hits++;
+            /* move it in front of the list */
+            if(entry != draw_text_cache.entries)
+            {
+                draw_text_cache_entry_list_detach(&draw_text_cache.entries, entry);
+                draw_text_cache_entry_list_push(&draw_text_cache.entries, entry);
+            }
+            return entry;
+        }
+
+    draw_text_cache.misses++;
+
+    entry = p_new(draw_text_cache_entry_t, 1);
+    draw_parser_data_init(&entry->pdata);
+
+    if(!draw_text_markup_expand(&entry->pdata, text, len))
+    {
+        /* draw the raw text */
+        draw_parser_data_wipe(&entry->pdata);
+        draw_parser_data_init(&entry->pdata);
+        entry->pdata.text = p_new(char, len + 1);
+        if(len)
+            memcpy(entry->pdata.text, text, len);
+        entry->pdata.len = len;
+    }
+
+    entry->font = pango_font_description_copy(font->desc);
+    entry->markup = p_dup(text, len);
+    entry->len = len;
+    entry->width = width;
+    entry->height = height;
+    entry->ellip = ellip;
+    entry->wrap = wrap;
+    entry->hash = hash;
+
+    draw_text_cache_entry_list_push(&draw_text_cache.entries, entry);
+
+    /* evict the least recently used entry */
+    if(++draw_text_cache.len > DRAW_TEXT_CACHE_SIZE)
+    {
+        draw_text_cache_entry_t *old = *draw_text_cache_entry_list_last(&draw_text_cache.entries);
+        draw_text_cache_entry_list_detach(&draw_text_cache.entries, old);
+        draw_text_cache_entry_delete(&old);
+        draw_text_cache.len--;
+    }
+
+    return entry;
+}
+
+/** Get the text cache statistics.
+ * \param hits The number of cache hits.
+ * \param misses The number of cache misses.
+ * \param len The number of entries in the cache.
+ */
+void
+draw_text_cache_stats(unsigned int *hits, unsigned int *misses, int *len)
+{
+    *hits = draw_text_cache.hits;
+    *misses = draw_text_cache.misses;
+    *len = draw_text_cache.len;
+}
+
 /** Initialize a new draw context.
  * \param d The draw context to initialize.
  * \param phys_screen Physical screen id.
@@ -343,22 +865,12 @@ draw_text(draw_context_t *ctx, font_t *font, PangoEllipsizeMode ellip, PangoWrap
 {
     int x, y;
     PangoRectangle ext;
-    draw_parser_data_t parser_data;
+    draw_text_cache_entry_t *entry = NULL;
 
     if(!pdata)
     {
-        draw_parser_data_init(&parser_data);
-        if(draw_text_markup_expand(&parser_data, text, len))
-        {
-            text = parser_data.text;
-            len = parser_data.len;
-        }
-        pdata = &parser_data;
-    }
-    else
-    {
-        text = pdata->text;
-        len = pdata->len;
+        entry = draw_text_cache_get(font, text, len, area.width, area.height, ellip, wrap);
+        pdata = &entry->pdata;
     }
 
     if(pdata->has_bg_color)
@@ -398,7 +910,18 @@ draw_text(draw_context_t *ctx, font_t *font, PangoEllipsizeMode ellip, PangoWrap
     pango_layout_set_wrap(ctx->layout, wrap);
     pango_layout_set_attributes(ctx->layout, pdata->attr_list);
     pango_layout_set_font_description(ctx->layout, font->desc);
-    pango_layout_get_pixel_extents(ctx->layout, NULL, &ext);
+
+    if(entry && entry->has_extents)
+        ext = entry->extents;
+    else
+    {
+        pango_layout_get_pixel_extents(ctx->layout, NULL, &ext);
+        if(entry)
+        {
+            entry->extents = ext;
+            entry->has_extents = true;
+        }
+    }
 
     x = area.x + pdata->margin.left;
     /* + 1 is added for rounding, so that in any case of doubt we rather draw
@@ -439,9 +962,145 @@ draw_text(draw_context_t *ctx, font_t *font, PangoEllipsizeMode ellip, PangoWrap
                           ctx->fg.alpha / 65535.0);
     pango_cairo_update_layout(ctx->cr, ctx->layout);
     pango_cairo_show_layout(ctx->cr, ctx->layout);
+}
+
+/** What identifies a gradient: 32 bits coordinates, so that none gets
+ * truncated, then 16 bits fields, so there is no padding and it can be
+ * hashed and compared as a whole. */
+typedef struct
+{
+    int32_t x, y, x_offset, y_offset;
+    /** Red, green, blue and alpha of the start, center and end colors */
+    uint16_t colors[3][4];
+    uint16_t has_center, has_end;
+} draw_gradient_key_t;
+
+typedef struct draw_gradient_cache_entry_t draw_gradient_cache_entry_t;
+/** A gradient pattern, as kept in the gradient cache. */
+struct draw_gradient_cache_entry_t
+{
+    draw_gradient_key_t key;
+    uint32_t hash;
+    /** The pattern, the cache owns one reference */
+    cairo_pattern_t *pattern;
+    /** Next and previous entries, most recently used first */
+    draw_gradient_cache_entry_t *prev, *next;
+};
+
+static void
+draw_gradient_cache_entry_delete(draw_gradient_cache_entry_t **entry)
+{
+    cairo_pattern_destroy((*entry)->pattern);
+    p_delete(entry);
+}
+
+DO_SLIST(draw_gradient_cache_entry_t, draw_gradient_cache_entry, draw_gradient_cache_entry_delete)
+
+/** The gradient cache, shared by every gradient drawing function. */
+static struct
+{
+    /** Entries, most recently used first */
+    draw_gradient_cache_entry_t *entries;
+    /** Number of entries */
+    int len;
+} draw_gradient_cache;
+
+/** Store a color in a gradient key.
+ * \param dst Where to store the color components.
+ * \param color The color.
+ */
+static inline void
+draw_gradient_key_color(uint16_t dst[4], const xcolor_t *color)
+{
+    dst[0] = color->red;
+    dst[1] = color->green;
+    dst[2] = color->blue;
+    dst[3] = color->alpha;
+}
+
+/** Add a color stop to a pattern.
+ * \param pat The pattern.
+ * \param offset The stop offset.
+ * \param color The color components, as stored in a gradient key.
+ */
+static inline void
+draw_gradient_add_stop(cairo_pattern_t *pat, double offset, const uint16_t color[4])
+{
+    cairo_pattern_add_color_stop_rgba(pat, offset,
+                                      color[0] / 65535.0,
+                                      color[1] / 65535.0,
+                                      color[2] / 65535.0,
+                                      color[3] / 65535.0);
+}
+
+/** Get a linear gradient pattern from the gradient cache, creating it if
+ * needed.
+ * \param gradient_vector x, y to x + x_offset, y + y_offset.
+ * \param pcolor Color to use at start of gradient_vector.
+ * \param pcolor_center Color at center of gradient_vector, if initialized.
+ * \param pcolor_end Color at end of gradient_vector, if initialized.
+ * \return A new reference to the pattern.
+ */
+static cairo_pattern_t *
+draw_gradient_cache_get(vector_t gradient_vector, const xcolor_t *pcolor,
+                        const xcolor_t *pcolor_center, const xcolor_t *pcolor_end)
+{
+    draw_gradient_cache_entry_t *entry;
+    draw_gradient_key_t key;
+    uint32_t hash;
+
+    p_clear(&key, 1);
+    key.x = gradient_vector.x;
+    key.y = gradient_vector.y;
+    key.x_offset = gradient_vector.x_offset;
+    key.y_offset = gradient_vector.y_offset;
+    draw_gradient_key_color(key.colors[0], pcolor);
+    if((key.has_center = pcolor_center->initialized))
+        draw_gradient_key_color(key.colors[1], pcolor_center);
+    /* pcolor is always set (so far in awesome), it ends the gradient if
+     * there is no end color */
+    if((key.has_end = pcolor_end->initialized))
+        draw_gradient_key_color(key.colors[2], pcolor_end);
+    else
+        draw_gradient_key_color(key.colors[2], pcolor);
+
+    hash = a_memhash(&key, sizeof(key));
+
+    for(entry = draw_gradient_cache.entries; entry; entry = entry->next)
+        if(entry->hash == hash && !memcmp(&entry->key, &key, sizeof(key)))
+        {
+            if(entry != draw_gradient_cache.entries)
+            {
+                draw_gradient_cache_entry_list_detach(&draw_gradient_cache.entries, entry);
+                draw_gradient_cache_entry_list_push(&draw_gradient_cache.entries, entry);
+            }
+            return cairo_pattern_reference(entry->pattern);
+        }
+
+    entry = p_new(draw_gradient_cache_entry_t, 1);
+    entry->key = key;
+    entry->hash = hash;
+    entry->pattern = cairo_pattern_create_linear(key.x, key.y,
+                                                 key.x + key.x_offset,
+                                                 key.y + key.y_offset);
+    draw_gradient_add_stop(entry->pattern, 0.0, key.colors[0]);
+    if(key.has_center)
+        draw_gradient_add_stop(entry->pattern, 0.5, key.colors[1]);
+    draw_gradient_add_stop(entry->pattern, 1.0, key.colors[2]);
+
+    draw_gradient_cache_entry_list_push(&draw_gradient_cache.entries, entry);
+
+    /* evict the least recently used entry: patterns still in use by a
+     * caller stay alive until it releases them */
+    if(++draw_gradient_cache.len > DRAW_GRADIENT_CACHE_SIZE)
+    {
+        draw_gradient_cache_entry_t *old = *draw_gradient_cache_entry_list_last(&draw_gradient_cache.entries);
+        draw_gradient_cache_entry_list_detach(&draw_gradient_cache.entries, old);
+        draw_gradient_cache_entry_delete(&old);
+        draw_gradient_cache.len--;
+    }
 
-    if (pdata == &parser_data)
-        draw_parser_data_wipe(&parser_data);
+    return cairo_pattern_reference(entry->pattern);
 }
 
 /** Setup color-source for cairo (gradient or mono).
@@ -451,6 +1110,8 @@ draw_text(draw_context_t *ctx, font_t *font, PangoEllipsizeMode ellip, PangoWrap
  * \param pcolor_center Color at center of gradient_vector.
  * \param pcolor_end Color at end of gradient_vector.
  * \return pat Pattern or NULL, needs to get cairo_pattern_destroy()'ed.
+ * Gradient patterns come from the gradient cache, so this only drops the
+ * caller reference.
  */
 static cairo_pattern_t *
 draw_setup_cairo_color_source(draw_context_t *ctx, vector_t gradient_vector,
@@ -458,11 +1119,9 @@ draw_setup_cairo_color_source(draw_context_t *ctx, vector_t gradient_vector,
                               const xcolor_t *pcolor_end)
 {
     cairo_pattern_t *pat = NULL;
-    bool has_center = pcolor_center->initialized;
-    bool has_end    = pcolor_end->initialized;
 
     /* no need for a real pattern: */
-    if(!has_end && !has_center)
+    if(!pcolor_end->initialized && !pcolor_center->initialized)
         cairo_set_source_rgba(ctx->cr,
                               pcolor->red / 65535.0,
                               pcolor->green / 65535.0,
@@ -470,37 +1129,7 @@ draw_setup_cairo_color_source(draw_context_t *ctx, vector_t gradient_vector,
                               pcolor->alpha / 65535.0);
     else
     {
-        pat = cairo_pattern_create_linear(gradient_vector.x,
-                                          gradient_vector.y,
-                                          gradient_vector.x + gradient_vector.x_offset,
-                                          gradient_vector.y + gradient_vector.y_offset);
-
-        /* pcolor is always set (so far in awesome) */
-        cairo_pattern_add_color_stop_rgba(pat, 0.0,
-                                          pcolor->red / 65535.0,
-                                          pcolor->green / 65535.0,
-                                          pcolor->blue / 65535.0,
-                                          pcolor->alpha / 65535.0);
-
-        if(has_center)
-            cairo_pattern_add_color_stop_rgba(pat, 0.5,
-                                              pcolor_center->red / 65535.0,
-                                              pcolor_center->green / 65535.0,
-                                              pcolor_center->blue / 65535.0,
-                                              pcolor_center->alpha / 65535.0);
-
-        if(has_end)
-            cairo_pattern_add_color_stop_rgba(pat, 1.0,
-                                              pcolor_end->red / 65535.0,
-                                              pcolor_end->green / 65535.0,
-                                              pcolor_end->blue / 65535.0,
-                                              pcolor_end->alpha / 65535.0);
-        else
-            cairo_pattern_add_color_stop_rgba(pat, 1.0,
-                                              pcolor->red / 65535.0,
-                                              pcolor->green / 65535.0,
-                                              pcolor->blue / 65535.0,
-                                              pcolor->alpha / 65535.0);
+        pat = draw_gradient_cache_get(gradient_vector, pcolor, pcolor_center, pcolor_end);
         cairo_set_source(ctx->cr, pat);
     }
     return pat;
@@ -599,6 +1228,7 @@ draw_graph_setup(draw_context_t *ctx)
  * \param from Array of starting-point offsets to draw a graph lines.
  * \param to Array of end-point offsets to draw a graph lines.
  * \param cur_index Current position in data-array (cycles around).
+ * \param count Number of lines to draw, beginning with the newest value.
  * \param grow Put new values to the left or to the right.
  * \param gradient_vector Color-Gradient course.
  * \param pcolor Color at start of gradient_vector.
@@ -607,20 +1237,22 @@ draw_graph_setup(draw_context_t *ctx)
  */
 void
 draw_graph(draw_context_t *ctx, area_t rect, int *from, int *to, int cur_index,
-           position_t grow, vector_t gradient_vector, const xcolor_t *pcolor,
+           int count, position_t grow, vector_t gradient_vector, const xcolor_t *pcolor,
            const xcolor_t *pcolor_center, const xcolor_t *pcolor_end)
 {
     int i = -1;
     float x = rect.x + 0.5; /* middle of a pixel */
     cairo_pattern_t *pat;
 
+    count = MIN(count, rect.width);
+
     pat = draw_setup_cairo_color_source(ctx, gradient_vector,
                                         pcolor, pcolor_center, pcolor_end);
 
     if(grow == Right) /* draw from right to left */
     {
         x += rect.width - 1;
-        while(++i < rect.width)
+        while(++i < count)
         {
             cairo_move_to(ctx->cr, x, rect.y - from[cur_index]);
             cairo_line_to(ctx->cr, x, rect.y - to[cur_index]);
@@ -631,7 +1263,7 @@ draw_graph(draw_context_t *ctx, area_t rect, int *from, int *to, int cur_index,
         }
     }
     else /* draw from left to right */
-        while(++i < rect.width)
+        while(++i < count)
         {
             cairo_move_to(ctx->cr, x, rect.y - from[cur_index]);
             cairo_line_to(ctx->cr, x, rect.y - to[cur_index]);
@@ -652,6 +1284,8 @@ draw_graph(draw_context_t *ctx, area_t rect, int *from, int *to, int cur_index,
  * \param rect The area to draw into.
  * \param to array of offsets to draw the line through...
  * \param cur_index current position in data-array (cycles around)
+ * \param count number of values to draw the line through, beginning with the
+ * newest one
  * \param grow put new values to the left or to the right
  * \param gradient_vector Color-gradient course.
  * \param pcolor Color at start of gradient_vector.
@@ -659,7 +1293,7 @@ draw_graph(draw_context_t *ctx, area_t rect, int *from, int *to, int cur_index,
  * \param pcolor_end Color at end of gradient_vector.
  */
 void
-draw_graph_line(draw_context_t *ctx, area_t rect, int *to, int cur_index,
+draw_graph_line(draw_context_t *ctx, area_t rect, int *to, int cur_index, int count,
                 position_t grow, vector_t gradient_vector, const xcolor_t *pcolor,
                 const xcolor_t *pcolor_center, const xcolor_t *pcolor_end)
 {
@@ -681,12 +1315,15 @@ draw_graph_line(draw_context_t *ctx, area_t rect, int *to, int cur_index,
     x = rect.x + 0.5;
     y = rect.y + 0.5;
     w = rect.width;
+    count = MIN(count, w);
 
     if(grow == Right)
     {
-        /* go through the values from old to new. Begin with the oldest. */
-        if(++cur_index > w - 1)
-            cur_index = 0;
+        /* go through the values from old to new. Begin with the oldest one
+         * we draw. */
+        x += w - count;
+        if((cur_index -= count - 1) < 0)
+            cur_index += w;
 
         cairo_move_to(ctx->cr, x, y - to[cur_index]);
     }
@@ -694,7 +1331,7 @@ draw_graph_line(draw_context_t *ctx, area_t rect, int *to, int cur_index,
         /* on the left border: fills a pixel also when there's only one value */
         cairo_move_to(ctx->cr, x - 1.0, y - to[cur_index]);
 
-    for(i = 0; i < w; i++)
+    for(i = 0; i < count; i++)
     {
         cairo_line_to(ctx->cr, x, y - to[cur_index]);
         x += 1.0;
@@ -775,7 +1412,17 @@ draw_image_from_argb_data(draw_context_t *ctx, int x, int y, int w, int h,
 void
 draw_image(draw_context_t *ctx, int x, int y, int wanted_h, image_t *image)
 {
-    draw_image_from_argb_data(ctx, x, y, image->width, image->height, wanted_h, image->data);
+    if(wanted_h > 0 && image->height > 0 && wanted_h != image->height)
+    {
+        /* scaling is done once, then the scaled copy is only blitted */
+        cairo_t *cr = cairo_create(ctx->surface);
+        cairo_set_source_surface(cr, image_scaled_get(image, wanted_h), x, y);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+    }
+    else
+        draw_image_from_argb_data(ctx, x, y, image->width, image->height, 0,
+                                  image_data_argb32_get(image));
 }
 
 /** Rotate a pixmap.
@@ -830,16 +1477,26 @@ draw_text_extents(font_t *font, const char *text, ssize_t len, draw_parser_data_
     cairo_surface_t *surface;
     cairo_t *cr;
     PangoLayout *layout;
-    PangoRectangle ext;
-    xcb_screen_t *s = xutil_screen_get(globalconf.connection, globalconf.default_screen);
+    xcb_screen_t *s;
+    draw_text_cache_entry_t *entry;
     area_t geom = { 0, 0, 0, 0 };
 
     if(!len)
         return geom;
 
-    if(!draw_text_markup_expand(parser_data, text, len))
+    entry = draw_text_cache_get(font, text, len, -1, -1,
+                                PANGO_ELLIPSIZE_NONE, PANGO_WRAP_WORD);
+
+    draw_parser_data_copy(parser_data, &entry->pdata);
+
+    if(entry->has_extents)
+    {
+        geom.width = entry->extents.width;
+        geom.height = entry->extents.height * 1.5;
         return geom;
+    }
 
+    s = xutil_screen_get(globalconf.connection, globalconf.default_screen);
     surface = cairo_xcb_surface_create(globalconf.connection,
                                        globalconf.default_screen,
                                        draw_screen_default_visual(s),
@@ -851,13 +1508,15 @@ draw_text_extents(font_t *font, const char *text, ssize_t len, draw_parser_data_
     pango_layout_set_text(layout, parser_data->text, parser_data->len);
     pango_layout_set_attributes(layout, parser_data->attr_list);
     pango_layout_set_font_description(layout, font->desc);
-    pango_layout_get_pixel_extents(layout, NULL, &ext);
+    pango_layout_get_pixel_extents(layout, NULL, &entry->extents);
     g_object_unref(layout);
     cairo_destroy(cr);
     cairo_surface_destroy(surface);
 
-    geom.width = ext.width;
-    geom.height = ext.height * 1.5;
+    entry->has_extents = true;
+
+    geom.width = entry->extents.width;
+    geom.height = entry->extents.height * 1.5;
 
     return geom;
 }
@@ -33,6 +33,11 @@
 #include "common/buffer.h"
 #include "common/xutil.h"
 
+/** Maximum number of entries in the text cache. */
+#define DRAW_TEXT_CACHE_SIZE 128
+/** Maximum number of entries in the gradient cache. */
+#define DRAW_GRADIENT_CACHE_SIZE 32
+
 typedef struct
 {
     unsigned initialized : 1;
@@ -57,11 +62,11 @@ typedef struct vector_t vector_t;
 struct vector_t
 {
     /** Co-ords of starting point */
-    int16_t x;
-    int16_t y;
+    int32_t x;
+    int32_t y;
     /** Offset to starting point */
-    int16_t x_offset;
-    int16_t y_offset;
+    int32_t x_offset;
+    int32_t y_offset;
 };
 
 typedef struct area_t area_t;
@@ -183,13 +188,14 @@ void draw_rectangle_gradient(draw_context_t *, area_t, float, bool, vector_t,
                              const xcolor_t *, const xcolor_t *, const xcolor_t *);
 
 void draw_graph_setup(draw_context_t *);
-void draw_graph(draw_context_t *, area_t, int *, int *, int, position_t, vector_t,
+void draw_graph(draw_context_t *, area_t, int *, int *, int, int, position_t, vector_t,
                 const xcolor_t *, const xcolor_t *, const xcolor_t *);
-void draw_graph_line(draw_context_t *, area_t, int *, int, position_t, vector_t,
+void draw_graph_line(draw_context_t *, area_t, int *, int, int, position_t, vector_t,
                      const xcolor_t *, const xcolor_t *, const xcolor_t *);
 void draw_image(draw_context_t *, int, int, int, image_t *);
 void draw_rotate(draw_context_t *, xcb_drawable_t, xcb_drawable_t, int, int, int, int, double, int, int);
 area_t draw_text_extents(font_t *, const char *, ssize_t, draw_parser_data_t *);
+void draw_text_cache_stats(unsigned int *, unsigned int *, int *);
 alignment_t draw_align_fromstr(const char *, ssize_t);
 const char *draw_align_tostr(alignment_t);
 
@@ -227,5 +233,20 @@ draw_parser_data_wipe(draw_parser_data_t *pdata)
     }
 }
 
+/** Copy parser data, sharing its attributes and background image.
+ * \param dst The parser data to fill.
+ * \param src The parser data to copy.
+ */
+static inline void
+draw_parser_data_copy(draw_parser_data_t *dst, const draw_parser_data_t *src)
+{
+    *dst = *src;
+    if(dst->attr_list)
+        pango_attr_list_ref(dst->attr_list);
+    dst->text = a_strndup(src->text, src->len);
+    if(dst->bg_image)
+        image_ref(&dst->bg_image);
+}
+
 #endif
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
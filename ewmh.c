@@ -20,6 +20,7 @@
  */
 
 #include <sys/types.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include <xcb/xcb.h>
@@ -330,7 +331,7 @@ ewmh_process_state_atom(client_t *c, xcb_atom_t state, int set)
             c->isurgent = !c->isurgent;
 
         /* execute hook */
-        hooks_property(c, "urgent");
+        hooks_property(c, CLIENT_PROPERTY_URGENT);
     }
 }
 
@@ -551,32 +552,67 @@ ewmh_window_icon_get_unchecked(xcb_window_t w)
                                     _NET_WM_ICON, CARDINAL, 0, UINT32_MAX);
 }
 
-image_t *
-ewmh_window_icon_from_reply(xcb_get_property_reply_t *r)
+/** Update a client icon from a _NET_WM_ICON property. Among the icons set,
+ * the smallest one at least as large as the icon_size setting is chosen,
+ * or the largest one if they are all smaller. The icon is only decoded when
+ * it gets used.
+ * \param c The client.
+ * \param r The property reply, NULL if there is none.
+ * \return True if the property changed.
+ */
+bool
+ewmh_client_icon_update(client_t *c, xcb_get_property_reply_t *r)
 {
-    uint32_t *data;
+    uint32_t *data = NULL, *end, *best = NULL;
+    uint64_t hash = 0;
+    int len = 0, wanted = globalconf.icon_size > 0 ? globalconf.icon_size : INT_MAX;
 
-    if(!r || r->type != CARDINAL || r->format != 32 || r->length < 2 ||
-       !(data = (uint32_t *) xcb_get_property_value(r)))
-        return NULL;
+    if(r && r->type == CARDINAL && r->format == 32
+       && (data = (uint32_t *) xcb_get_property_value(r)))
+    {
+        len = xcb_get_property_value_length(r);
+        hash = a_memhash64(data, len);
+    }
 
-    if(data[0] && data[1])
-        return image_new_from_argb32(data[0], data[1], data + 2);
+    /* applications set the very same icon again and again */
+    if(len == c->icon_len && hash == c->icon_hash)
+        return false;
 
-    return NULL;
-}
+    c->icon_len = len;
+    c->icon_hash = hash;
+    image_unref(&c->icon);
+    p_delete(&c->icon_data);
 
-/** Get NET_WM_ICON.
- * \param cookie The cookie.
- * \return A draw_image_t structure which must be deleted after usage.
- */
-image_t *
-ewmh_window_icon_get_reply(xcb_get_property_cookie_t cookie)
-{
-    xcb_get_property_reply_t *r = xcb_get_property_reply(globalconf.connection, cookie, NULL);
-    image_t *icon = ewmh_window_icon_from_reply(r);
-    p_delete(&r);
-    return icon;
+    if(!len)
+        return true;
+
+    end = data + len / 4;
+
+    for(uint32_t *icon = data; end - icon >= 2; icon += 2 + icon[0] * icon[1])
+    {
+        int size, best_size;
+
+        if(!icon[0] || !icon[1]
+           || (uint64_t) icon[0] * icon[1] > (uint64_t) (end - icon - 2))
+            break;
+
+        size = MAX(icon[0], icon[1]);
+
+        if(!best)
+            best = icon;
+        else if((best_size = MAX(best[0], best[1])) < wanted ?
+                size > best_size : (size >= wanted && size < best_size))
+            best = icon;
+    }
+
+    if(best)
+    {
+        c->icon_width = best[0];
+        c->icon_height = best[1];
+        c->icon_data = p_dup(best + 2, best[0] * best[1]);
+    }
+
+    return true;
 }
 
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -37,8 +37,7 @@ void ewmh_client_update_hints(client_t *);
 void ewmh_update_workarea(int);
 void ewmh_client_strut_update(client_t *, xcb_get_property_reply_t *);
 xcb_get_property_cookie_t ewmh_window_icon_get_unchecked(xcb_window_t);
-image_t *ewmh_window_icon_from_reply(xcb_get_property_reply_t *);
-image_t *ewmh_window_icon_get_reply(xcb_get_property_cookie_t);
+bool ewmh_client_icon_update(client_t *, xcb_get_property_reply_t *);
 
 #endif
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
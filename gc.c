@@ -0,0 +1,169 @@
+/*
+ * gc.c - Lua garbage collection scheduling
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <ev.h>
+
+#include "structs.h"
+#include "gc.h"
+
+extern awesome_t globalconf;
+
+/** Idle collector state */
+static struct
+{
+    /** Starts the idle watcher once the heap has grown enough */
+    ev_prepare prepare;
+    /** Runs collection steps while the loop has nothing else to do */
+    ev_idle idle;
+    /** Allocation-driven collector pause and step multiplier */
+    int pause, stepmul;
+    /** Heap growth in percent of base after which the idle collector starts */
+    int threshold;
+    /** Size of one collection step */
+    int step;
+    /** Maximum number of seconds spent per idle run */
+    double slice;
+    /** Heap size in KiB when the last cycle finished */
+    int base;
+    /** Seconds spent collecting while idle */
+    double time;
+    /** Idle runs and completed cycles */
+    unsigned int slices, cycles;
+} gc =
+{
+    .pause = GC_PAUSE,
+    .stepmul = GC_STEPMUL,
+    .threshold = GC_IDLE_THRESHOLD,
+    .step = GC_IDLE_STEP,
+    .slice = GC_IDLE_SLICE,
+};
+
+static void
+gc_prepare_cb(EV_P_ ev_prepare *w, int revents)
+{
+    int threshold = MAX(gc.base / 100 * gc.threshold, GC_IDLE_THRESHOLD_MIN);
+
+    if(!ev_is_active(&gc.idle)
+       && lua_gc(globalconf.L, LUA_GCCOUNT, 0) - gc.base >= threshold)
+        ev_idle_start(EV_A_ &gc.idle);
+}
+
+static void
+gc_idle_cb(EV_P_ ev_idle *w, int revents)
+{
+    ev_tstamp start = ev_time(), now;
+    bool done = false;
+
+    /* at least one step, so that collection always progresses */
+    do
+    {
+        done = lua_gc(globalconf.L, LUA_GCSTEP, gc.step);
+        now = ev_time();
+    } while(!done && now - start < gc.slice);
+
+    gc.time += now - start;
+    gc.slices++;
+
+    /* a cycle is over: wait for the heap to grow again */
+    if(done)
+    {
+        gc.cycles++;
+        gc.base = lua_gc(globalconf.L, LUA_GCCOUNT, 0);
+        ev_idle_stop(EV_A_ w);
+    }
+}
+
+/** Apply the allocation-driven collector settings.
+ */
+static void
+gc_apply(void)
+{
+    lua_gc(globalconf.L, LUA_GCSETPAUSE, gc.pause);
+    lua_gc(globalconf.L, LUA_GCSETSTEPMUL, gc.stepmul);
+}
+
+/** Start collecting garbage while the main loop is idle.
+ */
+void
+gc_init(void)
+{
+    gc_apply();
+    gc.base = lua_gc(globalconf.L, LUA_GCCOUNT, 0);
+
+    ev_idle_init(&gc.idle, gc_idle_cb);
+    ev_prepare_init(&gc.prepare, gc_prepare_cb);
+    ev_prepare_start(globalconf.loop, &gc.prepare);
+    ev_unref(globalconf.loop);
+}
+
+/** Tune Lua garbage collection.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam A table with `pause' and `stepmul', the allocation-driven collector
+ * settings, `threshold', the heap growth in percent of the heap size after
+ * the last cycle, at least 64 KiB, after which garbage is collected while
+ * idle, `step', the size of one idle collection step, and
+ * `slice', the maximum number of seconds spent collecting per idle run.
+ */
+int
+luaA_gc(lua_State *L)
+{
+    luaA_checktable(L, 1);
+
+    gc.pause = MAX(luaA_getopt_number(L, 1, "pause", gc.pause), 0);
+    gc.stepmul = MAX(luaA_getopt_number(L, 1, "stepmul", gc.stepmul), 0);
+    gc.threshold = MAX(luaA_getopt_number(L, 1, "threshold", gc.threshold), 0);
+    gc.step = MAX(luaA_getopt_number(L, 1, "step", gc.step), 0);
+    gc.slice = MAX(luaA_getopt_number(L, 1, "slice", gc.slice), 0);
+
+    gc_apply();
+
+    return 0;
+}
+
+/** Get Lua garbage collection statistics.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn A table with `heap', the Lua heap size in bytes, `time', the
+ * seconds spent collecting while idle, `slices', the number of idle runs, and
+ * `cycles', the number of cycles they finished.
+ */
+int
+luaA_gc_stats(lua_State *L)
+{
+    double heap = lua_gc(L, LUA_GCCOUNT, 0) * 1024. + lua_gc(L, LUA_GCCOUNTB, 0);
+
+    lua_createtable(L, 0, 4);
+    lua_pushnumber(L, heap);
+    lua_setfield(L, -2, "heap");
+    lua_pushnumber(L, gc.time);
+    lua_setfield(L, -2, "time");
+    lua_pushnumber(L, gc.slices);
+    lua_setfield(L, -2, "slices");
+    lua_pushnumber(L, gc.cycles);
+    lua_setfield(L, -2, "cycles");
+
+    return 1;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
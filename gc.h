@@ -0,0 +1,48 @@
+/*
+ * gc.h - Lua garbage collection scheduling header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_GC_H
+#define AWESOME_GC_H
+
+#include "luaa.h"
+
+/** Default pause of the allocation-driven collector, in percent. It is
+ * above Lua's default so that most work is left to the idle collector. */
+#define GC_PAUSE 300
+/** Default step multiplier of the allocation-driven collector. */
+#define GC_STEPMUL 200
+/** Default heap growth, in percent of the heap size after the last cycle,
+ * after which the idle collector starts. */
+#define GC_IDLE_THRESHOLD 20
+/** Minimum heap growth, in KiB, after which the idle collector starts, so
+ * that a small heap is not collected over and over. */
+#define GC_IDLE_THRESHOLD_MIN 64
+/** Default size of one idle collection step, as passed to LUA_GCSTEP. */
+#define GC_IDLE_STEP 8
+/** Default maximum number of seconds spent collecting per idle run. */
+#define GC_IDLE_SLICE 0.001
+
+void gc_init(void);
+int luaA_gc(lua_State *);
+int luaA_gc_stats(lua_State *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -154,17 +154,22 @@ luaA_hooks_arrange(lua_State *L)
     return luaA_registerfct(L, 1, &globalconf.hooks.arrange);
 }
 
-/** Set the function called on each client's property change.
- * This function is called with the client object as argument and the
- * property name.
+/** Set the function called on client's property changes.
+ * Changes are gathered and this function is called once per client and
+ * main loop iteration, with the client object and a table whose keys are
+ * the names of the changed properties. A function set as immediate is
+ * called on each change instead; both functions can be set at once.
  * \param L The Lua VM state.
  * \return The number of elements pushed on stack.
  * \luastack
- * \lparam A function to call on each client property update.
+ * \lparam A function to call on client property updates.
+ * \lparam True to set the function called on each change (optional).
  */
 static int
 luaA_hooks_property(lua_State *L)
 {
+    if(lua_toboolean(L, 2))
+        return luaA_registerfct(L, 1, &globalconf.hooks.property_immediate);
     return luaA_registerfct(L, 1, &globalconf.hooks.property);
 }
 
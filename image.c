@@ -19,10 +19,62 @@
  *
  */
 
+#include <sys/stat.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "config.h"
+
+#ifdef WITH_JPEG
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
 #include "structs.h"
+#include "common/list.h"
+#include "common/premultiply.h"
 
 extern awesome_t globalconf;
 
+typedef struct image_cache_entry_t image_cache_entry_t;
+/** An image loaded from a file, as kept in the image cache. */
+struct image_cache_entry_t
+{
+    /** File path */
+    char *path;
+    /** File modification time and size when it was loaded */
+    time_t mtime;
+    off_t size;
+    /** The image, the cache holds one reference */
+    image_t *image;
+    /** Next and previous entries, most recently used first */
+    image_cache_entry_t *prev, *next;
+};
+
+static void
+image_cache_entry_delete(image_cache_entry_t **entry)
+{
+    p_delete(&(*entry)->path);
+    image_unref(&(*entry)->image);
+    p_delete(entry);
+}
+
+DO_SLIST(image_cache_entry_t, image_cache_entry, image_cache_entry_delete)
+
+/** The image cache, shared by everything loading images from files. */
+static struct
+{
+    /** Entries, most recently used first */
+    image_cache_entry_t *entries;
+    /** Number of entries */
+    int len;
+    /** Statistics */
+    unsigned int hits, misses;
+} image_cache;
+
 DO_LUA_NEW(extern, image_t, image, "image", image_ref)
 DO_LUA_GC(image_t, image, "image", image_unref)
 DO_LUA_EQ(image_t, image, "image")
@@ -67,39 +119,127 @@ image_imlib_load_strerror(Imlib_Load_Error e)
     return "unknown error";
 }
 
-/** Recompute the ARGB32 data from an image.
+/** Drop the ARGB32 data of an image, it will be computed again when needed.
  * \param image The image.
- * \return Data.
  */
 static void
 image_compute(image_t *image)
 {
-    int size, i;
-    uint32_t *data;
-    double alpha;
-    uint8_t *dataimg;
-
     imlib_context_set_image(image->image);
+    image->width = imlib_image_get_width();
+    image->height = imlib_image_get_height();
 
+    if(!image->data_is_imlib)
+        p_delete(&image->data);
+    image->data = NULL;
+    image->data_is_imlib = false;
+
+    for(int i = 0; i < image->scaled_len; i++)
+        cairo_surface_destroy(image->scaled[i].surface);
+    image->scaled_len = 0;
+}
+
+/** Premultiply Imlib2 image data. Opaque images are already
+ * premultiplied, so the Imlib2 data is used as is.
+ * This does not use Imlib2, and can run on any thread.
+ * \param data The Imlib2 image data.
+ * \param size The number of pixels.
+ * \param data_is_imlib Set to true if the Imlib2 data is returned.
+ * \return The image data, in cairo ARGB32 format.
+ */
+static uint8_t *
+image_premultiplied_new(const uint32_t *data, int size, bool *data_is_imlib)
+{
+    uint32_t *dataimg;
+    int i;
+
+    for(i = 0; i < size; i++)
+        if((data[i] >> 24) != 0xff)
+            break;
+
+    if((*data_is_imlib = (i == size)))
+        return (uint8_t *) data;
+
+    dataimg = p_new(uint32_t, size);
+    memcpy(dataimg, data, i * sizeof(uint32_t));
+    premultiply(dataimg + i, data + i, size - i);
+
+    return (uint8_t *) dataimg;
+}
+
+/** Get the premultiplied ARGB32 data of an image, computing it if needed.
+ * \param image The image.
+ * \return The image data, in cairo ARGB32 format.
+ */
+uint8_t *
+image_data_argb32_get(image_t *image)
+{
+    const uint32_t *data;
+
+    if(image->data)
+        return image->data;
+
+    imlib_context_set_image(image->image);
     data = imlib_image_get_data_for_reading_only();
 
-    image->width = imlib_image_get_width();
-    image->height = imlib_image_get_height();
+    image->data = image_premultiplied_new(data, image->width * image->height,
+                                          &image->data_is_imlib);
 
-    size = image->width * image->height;
+    return image->data;
+}
 
-    p_delete(&image->data);
-    image->data = dataimg = p_new(uint8_t, size * 4);
+/** Get a copy of an image scaled to a given height, keeping its aspect
+ * ratio. The last IMAGE_SCALED_MAX scaled copies are kept.
+ * \param image The image.
+ * \param height The wanted height.
+ * \return A cairo surface owned by the image.
+ */
+cairo_surface_t *
+image_scaled_get(image_t *image, int height)
+{
+    image_scaled_t scaled;
+    cairo_surface_t *source;
+    cairo_t *cr;
+    double ratio;
+    int i;
 
-    for(i = 0; i < size; i++, dataimg += 4)
-    {
-        dataimg[3] = (data[i] >> 24) & 0xff;           /* A */
-        /* cairo wants pre-multiplied alpha */
-        alpha = dataimg[3] / 255.0;
-        dataimg[2] = ((data[i] >> 16) & 0xff) * alpha; /* R */
-        dataimg[1] = ((data[i] >>  8) & 0xff) * alpha; /* G */
-        dataimg[0] = (data[i]         & 0xff) * alpha; /* B */
-    }
+    for(i = 0; i < image->scaled_len; i++)
+        if(image->scaled[i].height == height)
+        {
+            scaled = image->scaled[i];
+            memmove(image->scaled + 1, image->scaled, i * sizeof(image_scaled_t));
+            image->scaled[0] = scaled;
+            return scaled.surface;
+        }
+
+    ratio = (double) height / (double) image->height;
+
+    /* ARGB32 rows are never padded */
+    source = cairo_image_surface_create_for_data(image_data_argb32_get(image),
+                                                 CAIRO_FORMAT_ARGB32,
+                                                 image->width, image->height,
+                                                 4 * image->width);
+    scaled.height = height;
+    scaled.surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                MAX(1, round(image->width * ratio)),
+                                                height);
+    cr = cairo_create(scaled.surface);
+    cairo_scale(cr, ratio, ratio);
+    cairo_set_source_surface(cr, source, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BEST);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_destroy(source);
+
+    /* forget the least recently used one */
+    if(image->scaled_len == IMAGE_SCALED_MAX)
+        cairo_surface_destroy(image->scaled[--image->scaled_len].surface);
+
+    memmove(image->scaled + 1, image->scaled, image->scaled_len * sizeof(image_scaled_t));
+    image->scaled[0] = scaled;
+    image->scaled_len++;
+
+    return scaled.surface;
 }
 
 /** Create a new image from ARGB32 data.
@@ -114,7 +254,10 @@ image_new_from_argb32(int width, int height, uint32_t *data)
     Imlib_Image imimage;
     image_t *image = NULL;
 
-    if((imimage = imlib_create_image_using_data(width, height, data)))
+    /* the data does not outlive us, and the image data is computed lazily */
+    imimage = imlib_create_image_using_copied_data(width, height, data);
+
+    if(imimage)
     {
         image = p_new(image_t, 1);
         image->image = imimage;
@@ -124,9 +267,135 @@ image_new_from_argb32(int width, int height, uint32_t *data)
     return image;
 }
 
+/** Get the memory used by an image.
+ * \param image The image.
+ * \return The number of bytes used by the image pixels.
+ */
+static size_t
+image_memory(image_t *image)
+{
+    size_t size = (size_t) image->width * image->height * 4;
+
+    if(image->data && !image->data_is_imlib)
+        size *= 2;
+
+    for(int i = 0; i < image->scaled_len; i++)
+        size += (size_t) cairo_image_surface_get_width(image->scaled[i].surface)
+            * image->scaled[i].height * 4;
+
+    return size;
+}
+
+/** Evict the least recently used images which are only referenced by the
+ * image cache, until it fits in its limits.
+ */
+static void
+image_cache_evict(void)
+{
+    image_cache_entry_t *entry, *prev;
+    size_t memory = 0;
+
+    for(entry = image_cache.entries; entry; entry = entry->next)
+        memory += image_memory(entry->image);
+
+    if(image_cache.len <= IMAGE_CACHE_SIZE && memory <= IMAGE_CACHE_MEMORY)
+        return;
+
+    for(entry = *image_cache_entry_list_last(&image_cache.entries); entry; entry = prev)
+    {
+        prev = entry->prev;
+
+        /* images still in use would not be freed anyway, and the most
+         * recently used one is being handed out */
+        if(entry->image->refcount == 1 && entry != image_cache.entries)
+        {
+            memory -= image_memory(entry->image);
+            image_cache_entry_list_detach(&image_cache.entries, entry);
+            image_cache_entry_delete(&entry);
+            image_cache.len--;
+
+            if(image_cache.len <= IMAGE_CACHE_SIZE && memory <= IMAGE_CACHE_MEMORY)
+                return;
+        }
+    }
+}
+
+/** Look an image file up in the image cache. A stale entry is dropped.
+ * \param filename The image file.
+ * \return The cached image, or NULL if there is none.
+ */
+static image_t *
+image_cache_get(const char *filename)
+{
+    image_cache_entry_t *entry;
+    struct stat st;
+
+    if(stat(filename, &st) == 0)
+        for(entry = image_cache.entries; entry; entry = entry->next)
+            if(!a_strcmp(entry->path, filename))
+            {
+                if(entry->mtime == st.st_mtime && entry->size == st.st_size)
+                {
+                    image_cache.hits++;
+                    if(entry != image_cache.entries)
+                    {
+                        image_cache_entry_list_detach(&image_cache.entries, entry);
+                        image_cache_entry_list_push(&image_cache.entries, entry);
+                    }
+                    return entry->image;
+                }
+
+                /* the file changed: users keep their image, but it is gone
+                 * from the cache */
+                image_cache_entry_list_detach(&image_cache.entries, entry);
+                image_cache_entry_delete(&entry);
+                image_cache.len--;
+                break;
+            }
+
+    image_cache.misses++;
+
+    return NULL;
+}
+
+/** Add an image loaded from a file to the image cache, replacing any entry
+ * for the same file.
+ * \param filename The image file.
+ * \param image The image.
+ */
+static void
+image_cache_add(const char *filename, image_t *image)
+{
+    image_cache_entry_t *entry;
+    struct stat st;
+
+    if(stat(filename, &st))
+        return;
+
+    for(entry = image_cache.entries; entry; entry = entry->next)
+        if(!a_strcmp(entry->path, filename))
+        {
+            image_cache_entry_list_detach(&image_cache.entries, entry);
+            image_cache_entry_delete(&entry);
+            image_cache.len--;
+            break;
+        }
+
+    entry = p_new(image_cache_entry_t, 1);
+    entry->path = a_strdup(filename);
+    entry->mtime = st.st_mtime;
+    entry->size = st.st_size;
+    entry->image = image_ref(&image);
+    image_cache_entry_list_push(&image_cache.entries, entry);
+    image_cache.len++;
+    image_cache_evict();
+}
+
 /** Load an image from filename.
+ * Images are shared through the image cache: loading the same unmodified
+ * file again gives the same image.
  * \param filename The image file to load.
- * \return A new image.
+ * \return An image, which must be referenced to be kept.
  */
 image_t *
 image_new_from_file(const char *filename)
@@ -138,6 +407,9 @@ image_new_from_file(const char *filename)
     if(!filename)
         return NULL;
 
+    if((image = image_cache_get(filename)))
+        return image;
+
     if(!(imimage = imlib_load_image_with_error_return(filename, &e)))
     {
         warn("cannot load image %s: %s", filename, image_imlib_load_strerror(e));
@@ -149,9 +421,28 @@ image_new_from_file(const char *filename)
 
     image_compute(image);
 
+    image_cache_add(filename, image);
+
     return image;
 }
 
+/** Get the image cache statistics.
+ * \param hits The number of cache hits.
+ * \param misses The number of cache misses.
+ * \param len The number of entries in the cache.
+ * \param memory The memory used by the cached images, in bytes.
+ */
+void
+image_cache_stats(unsigned int *hits, unsigned int *misses, int *len, size_t *memory)
+{
+    *hits = image_cache.hits;
+    *misses = image_cache.misses;
+    *len = image_cache.len;
+    *memory = 0;
+    for(image_cache_entry_t *entry = image_cache.entries; entry; entry = entry->next)
+        *memory += image_memory(entry->image);
+}
+
 /** Create a new image object.
  * \param L The Lua stack.
  * \return The number of elements pushed on stack.
@@ -307,6 +598,528 @@ luaA_image_crop_and_scale(lua_State *L)
     return luaA_image_userdata_new(L, new);
 }
 
+/** An image loaded by a worker thread. */
+typedef struct image_async_request_t image_async_request_t;
+struct image_async_request_t
+{
+    /** File to load */
+    char *path;
+    /** The placeholder image, filled once loaded, or the cached image */
+    image_t *image;
+    /** Function to call once loaded */
+    luaA_ref callback;
+    /** The request has been cancelled */
+    bool cancelled;
+    /** The image was found in the image cache */
+    bool cached;
+    /** Why the worker could not decode the file, NULL if it did */
+    char *error;
+    /** What the worker decoded: straight ARGB32 data for Imlib2, and
+     * premultiplied data, or NULL if the image is opaque */
+    int width, height;
+    uint32_t *argb;
+    uint8_t *data;
+    /** Next request in its queue */
+    image_async_request_t *next;
+};
+
+static void
+image_async_request_delete(image_async_request_t **req)
+{
+    p_delete(&(*req)->argb);
+    p_delete(&(*req)->data);
+    p_delete(&(*req)->error);
+    luaA_unregister(globalconf.L, &(*req)->callback);
+    image_unref(&(*req)->image);
+    p_delete(&(*req)->path);
+    p_delete(req);
+}
+
+DO_ARRAY(image_async_request_t *, image_async_request, DO_NOTHING)
+
+/** The asynchronous image loader. */
+static struct
+{
+    /** Protects the queues and the cancelled flags */
+    pthread_mutex_t lock;
+    /** Signaled when a request is queued */
+    pthread_cond_t cond;
+    /** Requests waiting for a worker */
+    image_async_request_t *pending, *pending_last;
+    /** Requests handled by a worker */
+    image_async_request_t *done;
+    /** Requests in flight, only used by the main thread */
+    image_async_request_array_t requests;
+    /** Number of worker threads */
+    int nworkers;
+    /** Wakes the main loop up when requests are done */
+    ev_async done_watcher;
+} image_async = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+/** Image formats the workers can decode */
+typedef enum
+{
+    IMAGE_ASYNC_UNKNOWN = 0,
+    IMAGE_ASYNC_PNG,
+    IMAGE_ASYNC_JPEG
+} image_async_format_t;
+
+/** Guess the format of an image file from its signature.
+ * \param path The file path.
+ * \return The format.
+ */
+static image_async_format_t
+image_async_format(const char *path)
+{
+    static const uint8_t png[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const uint8_t jpeg[] = { 0xff, 0xd8, 0xff };
+    image_async_format_t ret = IMAGE_ASYNC_UNKNOWN;
+    uint8_t buf[sizeof(png)];
+    size_t len;
+    FILE *file;
+
+    if((file = fopen(path, "rb")))
+    {
+        len = fread(buf, 1, sizeof(buf), file);
+        if(len >= sizeof(png) && !memcmp(buf, png, sizeof(png)))
+            ret = IMAGE_ASYNC_PNG;
+        else if(len >= sizeof(jpeg) && !memcmp(buf, jpeg, sizeof(jpeg)))
+            ret = IMAGE_ASYNC_JPEG;
+        fclose(file);
+    }
+
+    return ret;
+}
+
+/** Decode a PNG image, from a worker thread.
+ * Imlib2 is not thread safe and is only used by the main thread, so
+ * workers decode with cairo, which gives premultiplied data.
+ * \param req The request.
+ */
+static void
+image_async_load_png(image_async_request_t *req)
+{
+    cairo_surface_t *surface;
+    const uint8_t *pixels;
+    int stride;
+    bool opaque = true;
+
+    surface = cairo_image_surface_create_from_png(req->path);
+    if(cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        req->error = a_strdup(cairo_status_to_string(cairo_surface_status(surface)));
+        cairo_surface_destroy(surface);
+        return;
+    }
+
+    cairo_surface_flush(surface);
+    req->width = cairo_image_surface_get_width(surface);
+    req->height = cairo_image_surface_get_height(surface);
+    stride = cairo_image_surface_get_stride(surface);
+    pixels = cairo_image_surface_get_data(surface);
+
+    /* RGB24 surfaces have an undefined alpha byte */
+    if(cairo_image_surface_get_format(surface) == CAIRO_FORMAT_ARGB32)
+    {
+        req->data = p_new(uint8_t, req->width * req->height * 4);
+        for(int y = 0; y < req->height; y++)
+            memcpy(req->data + y * req->width * 4, pixels + y * stride, req->width * 4);
+    }
+
+    req->argb = p_new(uint32_t, req->width * req->height);
+    for(int y = 0; y < req->height; y++)
+    {
+        const uint32_t *row = (const uint32_t *) (pixels + y * stride);
+        uint32_t *dst = req->argb + y * req->width;
+
+        for(int x = 0; x < req->width; x++)
+        {
+            uint32_t p = row[x], a = req->data ? p >> 24 : 0xff;
+
+            if(a == 0xff)
+                dst[x] = p | 0xff000000;
+            else
+            {
+                opaque = false;
+                dst[x] = a ? (a << 24)
+                    | (((((p >> 16) & 0xff) * 255 + a / 2) / a) << 16)
+                    | (((((p >> 8) & 0xff) * 255 + a / 2) / a) << 8)
+                    | (((p & 0xff) * 255 + a / 2) / a) : 0;
+            }
+        }
+    }
+
+    /* opaque data is the same either way, and Imlib2 data is used then */
+    if(opaque)
+        p_delete(&req->data);
+
+    cairo_surface_destroy(surface);
+}
+
+#ifdef WITH_JPEG
+/** libjpeg error manager, jumping back to the decoder on errors. */
+typedef struct
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jmp;
+} image_jpeg_error_t;
+
+static void
+image_jpeg_error_exit(j_common_ptr cinfo)
+{
+    longjmp(((image_jpeg_error_t *) cinfo->err)->jmp, 1);
+}
+
+/** libjpeg warnings, such as a truncated file, are not worth a message. */
+static void
+image_jpeg_output_message(j_common_ptr cinfo __attribute__ ((unused)))
+{
+}
+
+/** Decode a JPEG image, from a worker thread. JPEG images are opaque, so
+ * only the Imlib2 data is filled.
+ * \param req The request.
+ */
+static void
+image_async_load_jpeg(image_async_request_t *req)
+{
+    struct jpeg_decompress_struct cinfo;
+    image_jpeg_error_t jerr;
+    char msg[JMSG_LENGTH_MAX];
+    JSAMPARRAY row;
+    FILE *file;
+
+    if(!(file = fopen(req->path, "rb")))
+    {
+        req->error = a_strdup("cannot open file");
+        return;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = image_jpeg_error_exit;
+    jerr.pub.output_message = image_jpeg_output_message;
+    if(setjmp(jerr.jmp))
+    {
+        jerr.pub.format_message((j_common_ptr) &cinfo, msg);
+        req->error = a_strdup(msg);
+        p_delete(&req->argb);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    /* as large as cairo can handle */
+    if(cinfo.output_width > 32767 || cinfo.output_height > 32767)
+    {
+        req->error = a_strdup("image too large");
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return;
+    }
+
+    req->width = cinfo.output_width;
+    req->height = cinfo.output_height;
+    req->argb = p_new(uint32_t, req->width * req->height);
+    /* freed with the decompressor */
+    row = cinfo.mem->alloc_sarray((j_common_ptr) &cinfo, JPOOL_IMAGE, req->width * 3, 1);
+
+    while(cinfo.output_scanline < cinfo.output_height)
+    {
+        uint32_t *dst = req->argb + cinfo.output_scanline * req->width;
+
+        jpeg_read_scanlines(&cinfo, row, 1);
+        for(int x = 0; x < req->width; x++)
+            dst[x] = 0xff000000 | (row[0][3 * x] << 16) | (row[0][3 * x + 1] << 8) | row[0][3 * x + 2];
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+}
+#endif
+
+/** Decode an image, from a worker thread.
+ * Formats the workers cannot decode are not loaded at all rather than
+ * loaded by the main thread, which would stall it.
+ * \param req The request.
+ */
+static void
+image_async_load(image_async_request_t *req)
+{
+    switch(image_async_format(req->path))
+    {
+      case IMAGE_ASYNC_PNG:
+        image_async_load_png(req);
+        break;
+#ifdef WITH_JPEG
+      case IMAGE_ASYNC_JPEG:
+        image_async_load_jpeg(req);
+        break;
+#endif
+      default:
+        req->error = a_strdup("unsupported format, use image() to load it");
+        break;
+    }
+}
+
+/** Worker thread main function.
+ * \param arg Unused.
+ * \return Never returns.
+ */
+static void *
+image_async_worker(void *arg __attribute__ ((unused)))
+{
+    for(;;)
+    {
+        image_async_request_t *req;
+        bool cancelled;
+
+        pthread_mutex_lock(&image_async.lock);
+        while(!image_async.pending)
+            pthread_cond_wait(&image_async.cond, &image_async.lock);
+        req = image_async.pending;
+        if(!(image_async.pending = req->next))
+            image_async.pending_last = NULL;
+        cancelled = req->cancelled;
+        pthread_mutex_unlock(&image_async.lock);
+
+        if(!cancelled)
+            image_async_load(req);
+
+        pthread_mutex_lock(&image_async.lock);
+        req->next = image_async.done;
+        image_async.done = req;
+        pthread_mutex_unlock(&image_async.lock);
+
+        ev_async_send(globalconf.loop, &image_async.done_watcher);
+    }
+
+    return NULL;
+}
+
+/** Fill the placeholder of a request done by a worker with the loaded
+ * image, and add it to the image cache.
+ * \param req The request.
+ * \return True if the image has been loaded.
+ */
+static bool
+image_async_fill(image_async_request_t *req)
+{
+    Imlib_Image imimage;
+    image_t *image = req->image;
+
+    if(req->error)
+        return false;
+
+    if(!(imimage = imlib_create_image_using_copied_data(req->width, req->height, req->argb)))
+    {
+        req->error = a_strdup(image_imlib_load_strerror(IMLIB_LOAD_ERROR_OUT_OF_MEMORY));
+        return false;
+    }
+
+    imlib_context_set_image(imimage);
+    imlib_image_set_has_alpha(req->data != NULL);
+
+    /* drop the placeholder content */
+    imlib_context_set_image(image->image);
+    imlib_free_image();
+    image->image = imimage;
+    image_compute(image);
+    if(req->data)
+    {
+        image->data = req->data;
+        req->data = NULL;
+    }
+
+    image_cache_add(req->path, image);
+
+    return true;
+}
+
+/** Handle requests done by the workers: fill their placeholder with the
+ * loaded image and call their callback.
+ * \param loop The main loop.
+ * \param w The async watcher.
+ * \param revents Unused.
+ */
+static void
+image_async_done_cb(EV_P_ ev_async *w __attribute__ ((unused)),
+                    int revents __attribute__ ((unused)))
+{
+    image_async_request_t *req, *next;
+
+    pthread_mutex_lock(&image_async.lock);
+    req = image_async.done;
+    image_async.done = NULL;
+    pthread_mutex_unlock(&image_async.lock);
+
+    for(; req; req = next)
+    {
+        next = req->next;
+
+        for(int i = 0; i < image_async.requests.len; i++)
+            if(image_async.requests.tab[i] == req)
+            {
+                image_async_request_array_take(&image_async.requests, i);
+                break;
+            }
+
+        if(!req->cancelled)
+        {
+            if(req->cached || image_async_fill(req))
+            {
+                luaA_image_userdata_new(globalconf.L, req->image);
+                luaA_dofunction(globalconf.L, req->callback, 1, 0);
+            }
+            else
+            {
+                warn("cannot load image %s: %s", req->path, req->error);
+                lua_pushnil(globalconf.L);
+                lua_pushstring(globalconf.L, req->error);
+                luaA_dofunction(globalconf.L, req->callback, 2, 0);
+            }
+        }
+
+        image_async_request_delete(&req);
+    }
+}
+
+/** Start the worker threads.
+ */
+static void
+image_async_init(void)
+{
+    sigset_t all, old;
+
+    ev_async_init(&image_async.done_watcher, image_async_done_cb);
+    ev_async_start(globalconf.loop, &image_async.done_watcher);
+
+    /* signals are for the main loop */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    for(int i = 0; i < IMAGE_ASYNC_WORKERS; i++)
+    {
+        pthread_t thread;
+
+        if(pthread_create(&thread, NULL, image_async_worker, NULL))
+        {
+            warn("cannot create image loading thread: %s", strerror(errno));
+            break;
+        }
+        pthread_detach(thread);
+        image_async.nworkers++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/** Load an image from a file in the background.
+ * Only PNG files, and JPEG files if awesome is built with libjpeg, are
+ * decoded in the background. Other files are not loaded: image() has to be
+ * used for them, and blocks until they are decoded.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The image path.
+ * \lparam A function called with the loaded image, or with nil and an error
+ * message if it cannot be loaded.
+ * \lreturn The image if it is in the image cache, else an empty placeholder
+ * image, filled in place once loaded, or nil if too many images are being
+ * loaded.
+ */
+static int
+luaA_image_load_async(lua_State *L)
+{
+    const char *filename = luaL_checkstring(L, 1);
+    image_async_request_t *req;
+    uint32_t transparent = 0;
+    Imlib_Image imimage;
+    image_t *image;
+
+    luaA_checkfunction(L, 2);
+
+    if(!image_async.nworkers)
+        image_async_init();
+
+    if(!image_async.nworkers || image_async.requests.len >= IMAGE_ASYNC_QUEUE_MAX)
+    {
+        luaA_warn(L, "cannot load image %s in background", filename);
+        return 0;
+    }
+
+    req = p_new(image_async_request_t, 1);
+    req->path = a_strdup(filename);
+    req->callback = LUA_REFNIL;
+    luaA_registerfct(L, 2, &req->callback);
+    image_async_request_array_append(&image_async.requests, req);
+
+    /* a cached image is returned as is, and handed to the callback from the
+     * main loop like a loaded one */
+    if((image = image_cache_get(filename)))
+    {
+        req->image = image_ref(&image);
+        req->cached = true;
+        pthread_mutex_lock(&image_async.lock);
+        req->next = image_async.done;
+        image_async.done = req;
+        pthread_mutex_unlock(&image_async.lock);
+        ev_async_send(globalconf.loop, &image_async.done_watcher);
+        return luaA_image_userdata_new(L, image);
+    }
+
+    imimage = imlib_create_image_using_copied_data(1, 1, &transparent);
+
+    image = p_new(image_t, 1);
+    image->image = imimage;
+    image_compute(image);
+    req->image = image_ref(&image);
+
+    pthread_mutex_lock(&image_async.lock);
+    if(image_async.pending_last)
+        image_async.pending_last->next = req;
+    else
+        image_async.pending = req;
+    image_async.pending_last = req;
+    pthread_cond_signal(&image_async.cond);
+    pthread_mutex_unlock(&image_async.lock);
+
+    return luaA_image_userdata_new(L, image);
+}
+
+/** Cancel the background loading of an image: its callback will not be
+ * called, and its placeholder stays empty.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam A placeholder image returned by image.load_async().
+ */
+static int
+luaA_image_load_cancel(lua_State *L)
+{
+    image_t **image = luaA_checkudata(L, 1, "image");
+
+    for(int i = 0; i < image_async.requests.len; i++)
+    {
+        image_async_request_t *req = image_async.requests.tab[i];
+        if(req->image == *image && !req->cancelled)
+        {
+            pthread_mutex_lock(&image_async.lock);
+            req->cancelled = true;
+            pthread_mutex_unlock(&image_async.lock);
+            luaA_unregister(L, &req->callback);
+        }
+    }
+
+    return 0;
+}
+
 /** Image object.
  * \param L The Lua VM state.
  * \return The number of elements pushed on stack.
@@ -328,12 +1141,10 @@ luaA_image_index(lua_State *L)
     switch(a_tokenize(attr, len))
     {
       case A_TK_WIDTH:
-        imlib_context_set_image((*image)->image);
-        lua_pushnumber(L, imlib_image_get_width());
+        lua_pushnumber(L, (*image)->width);
         break;
       case A_TK_HEIGHT:
-        imlib_context_set_image((*image)->image);
-        lua_pushnumber(L, imlib_image_get_height());
+        lua_pushnumber(L, (*image)->height);
         break;
       default:
         return 0;
@@ -346,6 +1157,8 @@ const struct luaL_reg awesome_image_methods[] =
 {
     { "__call", luaA_image_new },
     { "argb32", luaA_image_argb32_new },
+    { "load_async", luaA_image_load_async },
+    { "load_cancel", luaA_image_load_cancel },
     { NULL, NULL }
 };
 const struct luaL_reg awesome_image_meta[] =
@@ -24,10 +24,30 @@
 
 #include <lua.h>
 #include <Imlib2.h>
+#include <cairo.h>
 
 #include "common/util.h"
 #include "common/refcount.h"
 
+/** Maximum number of images in the image cache. */
+#define IMAGE_CACHE_SIZE 64
+/** Memory above which unused images are evicted from the image cache. */
+#define IMAGE_CACHE_MEMORY (16 * 1024 * 1024)
+/** Maximum number of scaled copies kept by an image. */
+#define IMAGE_SCALED_MAX 4
+/** Number of threads loading images in the background. */
+#define IMAGE_ASYNC_WORKERS 2
+/** Maximum number of images being loaded in the background. */
+#define IMAGE_ASYNC_QUEUE_MAX 32
+
+typedef struct
+{
+    /** Height the image has been scaled to */
+    int height;
+    /** The scaled image */
+    cairo_surface_t *surface;
+} image_scaled_t;
+
 typedef struct
 {
     /** Reference counter */
@@ -38,8 +58,13 @@ typedef struct
     int width;
     /** Image height */
     int height;
-    /** Image data */
+    /** Premultiplied image data, computed on first use */
     uint8_t *data;
+    /** The data belongs to the Imlib2 image */
+    bool data_is_imlib;
+    /** Scaled copies, most recently used first */
+    image_scaled_t scaled[IMAGE_SCALED_MAX];
+    int scaled_len;
 } image_t;
 
 static inline void
@@ -49,7 +74,10 @@ image_delete(image_t **i)
     {
         imlib_context_set_image((*i)->image);
         imlib_free_image();
-        p_delete(&(*i)->data);
+        if(!(*i)->data_is_imlib)
+            p_delete(&(*i)->data);
+        for(int j = 0; j < (*i)->scaled_len; j++)
+            cairo_surface_destroy((*i)->scaled[j].surface);
         p_delete(i);
     }
 }
@@ -59,6 +87,8 @@ DO_RCNT(image_t, image, image_delete)
 image_t * image_new_from_file(const char *);
 image_t * image_new_from_argb32(int, int, uint32_t *);
 uint8_t * image_data_argb32_get(image_t *);
+cairo_surface_t * image_scaled_get(image_t *, int);
+void image_cache_stats(unsigned int *, unsigned int *, int *, size_t *);
 
 int luaA_image_userdata_new(lua_State *, image_t *);
 
@@ -49,6 +49,10 @@
 #include "event.h"
 #include "titlebar.h"
 #include "mouse.h"
+#include "spawn.h"
+#include "bytecode.h"
+#include "gc.h"
+#include "profile.h"
 #include "layouts/tile.h"
 #include "common/socket.h"
 #include "common/buffer.h"
@@ -61,6 +65,16 @@ extern const struct luaL_reg awesome_button_methods[];
 extern const struct luaL_reg awesome_button_meta[];
 extern const struct luaL_reg awesome_image_methods[];
 extern const struct luaL_reg awesome_image_meta[];
+extern const struct luaL_reg awesome_timeseries_methods[];
+extern const struct luaL_reg awesome_timeseries_meta[];
+extern const struct luaL_reg awesome_timer_methods[];
+extern const struct luaL_reg awesome_timer_meta[];
+extern const struct luaL_reg awesome_sampler_methods[];
+extern const struct luaL_reg awesome_sampler_meta[];
+extern const struct luaL_reg awesome_watch_methods[];
+extern const struct luaL_reg awesome_watch_meta[];
+extern const struct luaL_reg awesome_worker_methods[];
+extern const struct luaL_reg awesome_worker_meta[];
 extern const struct luaL_reg awesome_mouse_methods[];
 extern const struct luaL_reg awesome_mouse_meta[];
 extern const struct luaL_reg awesome_screen_methods[];
@@ -361,6 +375,91 @@ luaAe_ipairs(lua_State *L)
     return 3;
 }
 
+/** Give a coroutine the hook of the thread resuming it, so that it runs
+ * within the execution budget and gets profiled. The hook a coroutine
+ * inherits when it is created is stale once that call returned.
+ * \param L The Lua VM state.
+ * \param co The coroutine.
+ */
+static void
+luaA_coroutine_hook(lua_State *L, lua_State *co)
+{
+    lua_sethook(co, lua_gethook(L), lua_gethookmask(L), lua_gethookcount(L));
+}
+
+/** Replacement for coroutine.resume, calling the standard one.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_coroutine_resume(lua_State *L)
+{
+    lua_State *co = lua_tothread(L, 1);
+
+    luaL_argcheck(L, co, 1, "coroutine expected");
+    luaA_coroutine_hook(L, co);
+
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+
+    return lua_gettop(L);
+}
+
+/** Function returned by coroutine.wrap.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_coroutine_wrapped(lua_State *L)
+{
+    int nargs = lua_gettop(L);
+
+    luaA_coroutine_hook(L, lua_tothread(L, lua_upvalueindex(1)));
+
+    /* upvalue 2 is the standard coroutine.resume */
+    lua_pushvalue(L, lua_upvalueindex(2));
+    lua_insert(L, 1);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 2);
+    lua_call(L, nargs + 1, LUA_MULTRET);
+
+    /* errors are propagated, like the standard coroutine.wrap does */
+    if(!lua_toboolean(L, 1))
+    {
+        if(lua_isstring(L, 2))
+        {
+            luaL_where(L, 1);
+            lua_insert(L, 2);
+            lua_concat(L, 2);
+        }
+        lua_error(L);
+    }
+
+    return lua_gettop(L) - 1;
+}
+
+/** Replacement for coroutine.wrap.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_coroutine_wrap(lua_State *L)
+{
+    lua_State *co;
+
+    luaL_argcheck(L, lua_isfunction(L, 1) && !lua_iscfunction(L, 1), 1,
+                  "Lua function expected");
+
+    co = lua_newthread(L);
+    lua_pushvalue(L, 1);
+    lua_xmove(L, co, 1);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_pushcclosure(L, luaA_coroutine_wrapped, 2);
+
+    return 1;
+}
+
 /** Replace various standards Lua functions with our own.
  * \param L The Lua VM state.
  */
@@ -386,6 +485,15 @@ luaA_fixups(lua_State *L)
     lua_pushcfunction(L, luaA_ipairs_aux);
     lua_pushcclosure(L, luaAe_ipairs, 1);
     lua_settable(L, LUA_GLOBALSINDEX);
+    /* replace coroutine.resume and coroutine.wrap */
+    lua_getglobal(L, "coroutine");
+    lua_getfield(L, -1, "resume");
+    lua_pushvalue(L, -1);
+    lua_pushcclosure(L, luaA_coroutine_wrap, 1); /* wrap gets resume as upvalue */
+    lua_setfield(L, -3, "wrap");
+    lua_pushcclosure(L, luaA_coroutine_resume, 1);
+    lua_setfield(L, -2, "resume");
+    lua_pop(L, 1);
 }
 
 /** __next function for wtable objects.
@@ -474,7 +582,7 @@ luaA_wtable_newindex(lua_State *L)
     lua_rawset(L, lua_upvalueindex(1));
 
     if(invalid)
-        luaA_wibox_invalidate_byitem(L, lua_topointer(L, 1));
+        luaA_wibox_invalidate_bywtable(L, 1);
 
     return 0;
 }
@@ -596,133 +704,417 @@ luaA_isloop(lua_State *L, int idx)
     return false;
 }
 
-/** Object table.
- * This table can use safely object as key.
+/** Create a new object table.
+ * Objects are pushed as one canonical userdata each, so they are hashed
+ * by the underlying Lua table: lookups and writes are plain table ones.
+ * Object tables are registered with weak keys, so that unmanaged objects
+ * can be removed from their keys.
  * \param L The Lua VM state.
  * \return The number of elements pushed on stack.
  */
 int
-luaA_otable_index(lua_State *L)
+luaA_otable_new(lua_State *L)
 {
-    void **obj, **v;
+    lua_newtable(L);
+    lua_getfield(L, LUA_REGISTRYINDEX, LUAA_OTABLE_REGISTRY);
+    lua_pushvalue(L, -2);
+    lua_pushboolean(L, true);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+    return luaA_settype(L, "otable");
+}
+
+/** Remove an object from the keys of every object table.
+ * \param L The Lua VM state.
+ * \param obj The object.
+ */
+void
+luaA_otable_purge(lua_State *L, void *obj)
+{
+    /* without userdata, it cannot be a key */
+    if(!luaA_userdata_get(L, obj))
+        return;
 
-    if((obj = lua_touserdata(L, 2)))
+    lua_getfield(L, LUA_REGISTRYINDEX, LUAA_OTABLE_REGISTRY);
+    lua_pushnil(L);
+    while(lua_next(L, -2))
     {
-        /* begins at nil */
+        /* stack: object, registry, otable, true */
+        lua_pushvalue(L, -4);
         lua_pushnil(L);
-        while(lua_next(L, 1))
+        lua_rawset(L, -4);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 2);
+}
+
+/** A function which overran its execution budget */
+typedef struct
+{
+    /** The function reference */
+    luaA_ref ref;
+    /** The function, to tell it from a later one with the same reference */
+    const void *fct;
+    /** Hook name, or function definition place */
+    char *name;
+    /** Number of overruns */
+    unsigned int count;
+    /** True if the function is not called anymore */
+    bool disabled;
+} luaA_budget_overrun_t;
+
+static inline void
+luaA_budget_overrun_wipe(luaA_budget_overrun_t *overrun)
+{
+    p_delete(&overrun->name);
+}
+
+DO_ARRAY(luaA_budget_overrun_t, luaA_budget_overrun, luaA_budget_overrun_wipe)
+
+/** Execution budget of Lua calls from the event loop */
+static struct
+{
+    /** Seconds a call may run, 0 for no limit */
+    double time;
+    /** Instructions a call may run, 0 for no limit */
+    unsigned long instructions;
+    /** Overruns after which a function is not called anymore, 0 for never */
+    unsigned int disable_after;
+    /** Nesting level of calls */
+    int depth;
+    /** Deadline of the outermost call */
+    ev_tstamp deadline;
+    /** Instructions run by the outermost call */
+    unsigned long count;
+    /** True if the outermost call has been aborted */
+    bool exceeded;
+    /** Instructions between two runs of the count hook, 0 if it is unset */
+    int granularity;
+    /** Name of the callback run by the outermost call, while profiling */
+    char *root;
+    /** Functions which overran */
+    luaA_budget_overrun_array_t overruns;
+} luaA_budget = { .time = LUAA_BUDGET_TIME };
+
+/** Name a function reference after the hook it is registered as, or the
+ * place the function is defined at.
+ * \param L The Lua VM state.
+ * \param f The function reference.
+ * \return A newly allocated name.
+ */
+char *
+luaA_ref_name(lua_State *L, luaA_ref f)
+{
+    static const struct
+    {
+        const char *name;
+        luaA_ref *ref;
+    } hooks[] =
+    {
+        { "manage", &globalconf.hooks.manage },
+        { "unmanage", &globalconf.hooks.unmanage },
+        { "focus", &globalconf.hooks.focus },
+        { "unfocus", &globalconf.hooks.unfocus },
+        { "mouse_enter", &globalconf.hooks.mouse_enter },
+        { "arrange", &globalconf.hooks.arrange },
+        { "clients", &globalconf.hooks.clients },
+        { "tags", &globalconf.hooks.tags },
+        { "tagged", &globalconf.hooks.tagged },
+        { "property", &globalconf.hooks.property },
+        { "property_immediate", &globalconf.hooks.property_immediate },
+        { "timer", &globalconf.hooks.timer },
+    };
+    char *name = NULL;
+    lua_Debug ar;
+
+    for(int i = 0; i < countof(hooks); i++)
+        if(*hooks[i].ref == f)
         {
-            /* check the key against the key if the key is a userdata,
-             * otherwise check it again the value. */
-            if((v = lua_touserdata(L, -2))
-                && *v == *obj)
-                /* return value */
-                return 1;
-            else if((v = lua_touserdata(L, -1))
-                    && *v == *obj)
-            {
-                /* return key */
-                lua_pop(L, 1);
-                return 1;
-            }
-            /* removes 'value'; keeps 'key' for next iteration */
-            lua_pop(L, 1);
+            a_asprintf(&name, "%s hook", hooks[i].name);
+            return name;
         }
-        return 0;
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, f);
+    lua_getinfo(L, ">S", &ar);
+    a_asprintf(&name, "function %s:%d", ar.short_src, ar.linedefined);
+    return name;
+}
+
+/** Count hook shared by the execution budget and the profiler.
+ * \param L The Lua VM state.
+ * \param ar The current function.
+ */
+static void
+luaA_hook(lua_State *L, lua_Debug *ar)
+{
+    /* a coroutine still having the hook of a call which returned */
+    if(!luaA_budget.depth)
+    {
+        lua_sethook(L, NULL, 0, 0);
+        return;
     }
 
-    lua_rawget(L, 1);
-    return 1;
+    if(profile_pending)
+        profile_sample(L, luaA_budget.root);
+
+    luaA_budget.count += luaA_budget.granularity;
+
+    /* keep failing until the outermost call returns, so that pcall() in
+     * Lua code cannot swallow the error */
+    if((luaA_budget.instructions && luaA_budget.count > luaA_budget.instructions)
+       || (luaA_budget.time > 0 && ev_time() > luaA_budget.deadline))
+    {
+        luaA_budget.exceeded = true;
+        luaL_error(L, "execution budget exceeded");
+    }
 }
 
-/** Object table.
- * This table can use safely object as key.
+/** Call a Lua function like lua_pcall(), within the execution budget.
+ * Nested calls share the budget of the outermost one.
  * \param L The Lua VM state.
- * \return The number of elements pushed on stack.
+ * \param nargs The number of arguments.
+ * \param nret The number of results.
+ * \return The lua_pcall() status.
  */
-static int
-luaA_otable_newindex(lua_State *L)
+int
+luaA_pcall(lua_State *L, int nargs, int nret)
 {
-    void **obj, **v;
+    int ret;
 
-    if((obj = lua_touserdata(L, 2)))
+    if(!luaA_budget.depth++)
     {
-        /* begins at nil */
-        lua_pushnil(L);
-        while(lua_next(L, 1))
+        luaA_budget.exceeded = false;
+        luaA_budget.deadline = ev_time() + luaA_budget.time;
+        luaA_budget.count = 0;
+        luaA_budget.granularity = 0;
+        if(profile_running())
         {
-            if((v = lua_touserdata(L, -2))
-               && *v == *obj)
-            {
-                /* remove value */
-                lua_pop(L, 1);
-                /* push new value on top */
-                lua_pushvalue(L, 3);
-                /* set in table key = value */
-                lua_rawset(L, 1);
-                return 0;
-            }
-            /* removes 'value'; keeps 'key' for next iteration */
-            lua_pop(L, 1);
+            profile_idle();
+            luaA_budget.granularity = PROFILE_GRANULARITY;
         }
+        else if(luaA_budget.time > 0 || luaA_budget.instructions)
+            luaA_budget.granularity = LUAA_BUDGET_GRANULARITY;
+        if(luaA_budget.granularity)
+            lua_sethook(L, luaA_hook, LUA_MASKCOUNT, luaA_budget.granularity);
     }
 
-    lua_rawset(L, 1);
+    ret = lua_pcall(L, nargs, nret, 0);
 
-    return 0;
+    if(!--luaA_budget.depth && luaA_budget.granularity)
+        lua_sethook(L, NULL, 0, 0);
+
+    return ret;
+}
+
+/** Find the overrun record of a function.
+ * \param f The function reference.
+ * \param fct The function.
+ * \return The record, or NULL if the function never overran.
+ */
+static luaA_budget_overrun_t *
+luaA_budget_overrun_get(luaA_ref f, const void *fct)
+{
+    for(int i = 0; i < luaA_budget.overruns.len; i++)
+        if(luaA_budget.overruns.tab[i].ref == f
+           && luaA_budget.overruns.tab[i].fct == fct)
+            return &luaA_budget.overruns.tab[i];
+    return NULL;
 }
 
-/** Spawn a program.
- * This function is multi-head (Zaphod) aware and will set display to
- * the right screen according to mouse position.
+/** Record an overrun of a function.
  * \param L The Lua VM state.
- * \return The number of elements pushed on stack
- * \luastack
- * \lparam The command to launch.
- * \lparam The optional screen number to spawn the command on.
+ * \param f The function reference.
+ * \param fct The function.
  */
-static int
-luaA_spawn(lua_State *L)
+static void
+luaA_budget_overrun(lua_State *L, luaA_ref f, const void *fct)
 {
-    char *host, newdisplay[128];
-    const char *cmd;
-    int screen = 0, screenp, displayp;
+    luaA_budget_overrun_t *overrun;
+
+    if(!(overrun = luaA_budget_overrun_get(f, fct)))
+    {
+        luaA_budget_overrun_t new = { .ref = f, .fct = fct, .name = luaA_ref_name(L, f) };
+
+        luaA_budget_overrun_array_append(&luaA_budget.overruns, new);
+        overrun = &luaA_budget.overruns.tab[luaA_budget.overruns.len - 1];
+    }
 
-    if(lua_gettop(L) == 2)
+    overrun->count++;
+    warn("%s exceeded its execution budget and has been aborted", overrun->name);
+
+    if(luaA_budget.disable_after && overrun->count >= luaA_budget.disable_after)
     {
-        screen = luaL_checknumber(L, 2) - 1;
-        luaA_checkscreen(screen);
+        overrun->disabled = true;
+        warn("%s disabled after %u overruns", overrun->name, overrun->count);
     }
+}
+
+/** Execute an Lua function, within the execution budget.
+ * \param L The Lua stack.
+ * \param f The Lua function to execute.
+ * \param nargs The number of arguments for the Lua function.
+ * \param nret The number of returned value from the Lua function.
+ * \return True on no error, false otherwise.
+ */
+bool
+luaA_dofunction(lua_State *L, luaA_ref f, int nargs, int nret)
+{
+    const void *fct;
+    luaA_budget_overrun_t *overrun;
+    int ret;
 
-    cmd = luaL_checkstring(L, 1);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, f);
+    fct = lua_topointer(L, -1);
 
-    if(!globalconf.xinerama_is_active)
+    if(luaA_budget.overruns.len
+       && (overrun = luaA_budget_overrun_get(f, fct))
+       && overrun->disabled)
     {
-        xcb_parse_display(NULL, &host, &displayp, &screenp);
-        snprintf(newdisplay, sizeof(newdisplay), "%s:%d.%d", host, displayp, screen);
-        setenv("DISPLAY", newdisplay, 1);
-        p_delete(&host);
+        lua_pop(L, nargs + 1);
+        return false;
     }
 
-    /* The double-fork construct avoids zombie processes and keeps the code
-     * clean from stupid signal handlers. */
-    if(fork() == 0)
+    if(nargs)
+        lua_insert(L, - (nargs + 1));
+
+    if(!luaA_budget.depth && profile_running())
+        luaA_budget.root = luaA_ref_name(L, f);
+
+    ret = luaA_pcall(L, nargs, nret);
+
+    if(!luaA_budget.depth)
+        p_delete(&luaA_budget.root);
+
+    if(ret)
     {
-        if(fork() == 0)
+        /* the budget is charged to the outermost function only, a nested
+         * one is merely aborted with it */
+        if(luaA_budget.exceeded)
         {
-            if(globalconf.connection)
-                xcb_disconnect(globalconf.connection);
-            setsid();
-            a_exec(cmd);
-            warn("execl '%s' failed: %s\n", cmd, strerror(errno));
+            if(!luaA_budget.depth)
+                luaA_budget_overrun(L, f, fct);
         }
-        exit(EXIT_SUCCESS);
+        else
+            warn("error running function: %s",
+                 lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return false;
     }
-    wait(0);
+    return true;
+}
+
+/** Set the execution budget of Lua calls from the event loop.
+ * Functions disabled after overrunning it are enabled again.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam A table with `time', a number of seconds, `instructions', a number
+ * of Lua instructions, 0 for no limit, and `disable_after', a number of
+ * overruns after which a function is not called anymore, 0 for never.
+ */
+static int
+luaA_lua_budget(lua_State *L)
+{
+    luaA_checktable(L, 1);
+
+    luaA_budget.time = MAX(luaA_getopt_number(L, 1, "time", luaA_budget.time), 0);
+    luaA_budget.instructions = MAX(luaA_getopt_number(L, 1, "instructions",
+                                                      luaA_budget.instructions), 0);
+    luaA_budget.disable_after = MAX(luaA_getopt_number(L, 1, "disable_after",
+                                                       luaA_budget.disable_after), 0);
+
+    for(int i = 0; i < luaA_budget.overruns.len; i++)
+        luaA_budget.overruns.tab[i].disabled = false;
 
     return 0;
 }
 
+/** Get the execution budget overruns.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn A table with, for each hook or function which overran its budget,
+ * a table with `overruns', their number, and `disabled', true if it is not
+ * called anymore.
+ */
+static int
+luaA_lua_budget_stats(lua_State *L)
+{
+    lua_newtable(L);
+
+    for(int i = 0; i < luaA_budget.overruns.len; i++)
+    {
+        luaA_budget_overrun_t *overrun = &luaA_budget.overruns.tab[i];
+
+        lua_createtable(L, 0, 2);
+        lua_pushnumber(L, overrun->count);
+        lua_setfield(L, -2, "overruns");
+        lua_pushboolean(L, overrun->disabled);
+        lua_setfield(L, -2, "disabled");
+        lua_setfield(L, -2, overrun->name);
+    }
+
+    return 1;
+}
+
+/** Get the text cache statistics.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn A table with `hits', `misses', `entries' and `size' elements.
+ */
+static int
+luaA_text_cache_stats(lua_State *L)
+{
+    unsigned int hits, misses;
+    int len;
+
+    draw_text_cache_stats(&hits, &misses, &len);
+
+    lua_newtable(L);
+    lua_pushnumber(L, hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushnumber(L, misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, len);
+    lua_setfield(L, -2, "entries");
+    lua_pushnumber(L, DRAW_TEXT_CACHE_SIZE);
+    lua_setfield(L, -2, "size");
+
+    return 1;
+}
+
+/** Get the image cache statistics.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn A table with `hits', `misses', `entries', `size' and `memory'
+ * elements.
+ */
+static int
+luaA_image_cache_stats(lua_State *L)
+{
+    unsigned int hits, misses;
+    int len;
+    size_t memory;
+
+    image_cache_stats(&hits, &misses, &len, &memory);
+
+    lua_newtable(L);
+    lua_pushnumber(L, hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushnumber(L, misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, len);
+    lua_setfield(L, -2, "entries");
+    lua_pushnumber(L, IMAGE_CACHE_SIZE);
+    lua_setfield(L, -2, "size");
+    lua_pushnumber(L, memory);
+    lua_setfield(L, -2, "memory");
+
+    return 1;
+}
+
 /** Deprecated function, does nothing.
  */
 static int
@@ -738,6 +1130,8 @@ luaA_mouse_add(lua_State *L)
  * \luastack
  * \lfield font The default font.
  * \lfield conffile The configuration file which has been loaded.
+ * \lfield icon_size The preferred size of client icons, 0 for the largest.
+ * It is used when an icon is set, among the sizes the client offers.
  */
 static int
 luaA_awesome_index(lua_State *L)
@@ -766,6 +1160,9 @@ luaA_awesome_index(lua_State *L)
       case A_TK_BG:
         luaA_pushcolor(L, &globalconf.colors.bg);
         break;
+      case A_TK_ICON_SIZE:
+        lua_pushnumber(L, globalconf.icon_size);
+        break;
       default:
         return 0;
     }
@@ -803,6 +1200,9 @@ luaA_awesome_newindex(lua_State *L)
         if((buf = luaL_checklstring(L, 3, &len)))
            xcolor_init_reply(xcolor_init_unchecked(&globalconf.colors.bg, buf, len));
         break;
+      case A_TK_ICON_SIZE:
+        globalconf.icon_size = luaL_checknumber(L, 3);
+        break;
       default:
         return 0;
     }
@@ -824,8 +1224,6 @@ luaA_init(void)
     };
     static const struct luaL_reg otable_meta[] =
     {
-        { "__index", luaA_otable_index },
-        { "__newindex", luaA_otable_newindex },
         { NULL, NULL }
     };
     static const struct luaL_reg awesome_lib[] =
@@ -833,11 +1231,22 @@ luaA_init(void)
         { "quit", luaA_quit },
         { "exec", luaA_exec },
         { "spawn", luaA_spawn },
+        { "kill", luaA_kill },
         { "restart", luaA_restart },
         { "buttons", luaA_buttons },
         { "font_set", luaA_font_set },
         { "colors_set", luaA_colors_set },
         { "colors", luaA_colors },
+        { "text_cache_stats", luaA_text_cache_stats },
+        { "image_cache_stats", luaA_image_cache_stats },
+        { "load_stats", luaA_bytecode_stats },
+        { "lua_budget", luaA_lua_budget },
+        { "lua_budget_stats", luaA_lua_budget_stats },
+        { "gc", luaA_gc },
+        { "gc_stats", luaA_gc_stats },
+        { "profile_start", luaA_profile_start },
+        { "profile_stop", luaA_profile_stop },
+        { "profile_dump", luaA_profile_dump },
         { "__index", luaA_awesome_index },
         { "__newindex", luaA_awesome_newindex },
         /* deprecated */
@@ -851,6 +1260,23 @@ luaA_init(void)
 
     luaA_fixups(L);
 
+    /* canonical userdata are only kept while Lua uses them: finalized
+     * userdata are removed from weak tables before their __gc runs */
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushliteral(L, "v");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, LUAA_USERDATA_REGISTRY);
+
+    /* object tables */
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, LUAA_OTABLE_REGISTRY);
+
     /* Export awesome lib */
     luaA_openlib(L, "awesome", awesome_lib, awesome_lib);
 
@@ -875,6 +1301,21 @@ luaA_init(void)
     /* Export image */
     luaA_openlib(L, "image", awesome_image_methods, awesome_image_meta);
 
+    /* Export timeseries */
+    luaA_openlib(L, "timeseries", awesome_timeseries_methods, awesome_timeseries_meta);
+
+    /* Export timer */
+    luaA_openlib(L, "timer", awesome_timer_methods, awesome_timer_meta);
+
+    /* Export sampler */
+    luaA_openlib(L, "sampler", awesome_sampler_methods, awesome_sampler_meta);
+
+    /* Export watch */
+    luaA_openlib(L, "watch", awesome_watch_methods, awesome_watch_meta);
+
+    /* Export worker */
+    luaA_openlib(L, "worker", awesome_worker_methods, awesome_worker_meta);
+
     /* Export tag */
     luaA_openlib(L, "tag", awesome_tag_methods, awesome_tag_meta);
 
@@ -915,6 +1356,7 @@ luaA_init(void)
     globalconf.hooks.tags = LUA_REFNIL;
     globalconf.hooks.tagged = LUA_REFNIL;
     globalconf.hooks.property = LUA_REFNIL;
+    globalconf.hooks.property_immediate = LUA_REFNIL;
     globalconf.hooks.timer = LUA_REFNIL;
 
     /* add Lua lib path (/usr/share/awesome/lib by default) */
@@ -965,6 +1407,9 @@ luaA_init(void)
             p_delete(buf);
         p_delete(&xdg_files);
     }
+
+    /* load rc.lua and required modules through the bytecode cache */
+    bytecode_init(L);
 }
 
 #define AWESOME_CONFIG_FILE "/awesome/rc.lua"
@@ -974,7 +1419,7 @@ luaA_loadrc(const char *confpath, bool run)
 {
     if(confpath)
     {
-        if(!luaL_loadfile(globalconf.L, confpath))
+        if(!bytecode_loadfile(globalconf.L, confpath))
         {
             if(run)
             {
@@ -1088,7 +1533,8 @@ luaA_docmd(const char *cmd)
         oldtop = newtop;
 
         *p = '\0';
-        if (luaL_dostring(globalconf.L, cmd))
+        if(luaL_loadstring(globalconf.L, cmd)
+           || luaA_pcall(globalconf.L, 0, LUA_MULTRET))
         {
             warn("error executing Lua code: %s", lua_tostring(globalconf.L, -1));
             return 1;
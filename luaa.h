@@ -39,14 +39,25 @@ typedef int luaA_ref;
     luaA_warn(L, "%s: This function is deprecated and will be removed, see %s", \
               __FUNCTION__, repl)
 
+/** Registry key of the table of canonical userdata, indexed by C object. */
+#define LUAA_USERDATA_REGISTRY "awesome.userdata"
+
+/** Push the userdata of a C object: there is only one per object, kept in
+ * a weak table as long as Lua uses it.
+ */
 #define DO_LUA_NEW(decl, type, prefix, lua_type, type_ref) \
     decl int \
     luaA_##prefix##_userdata_new(lua_State *L, type *p) \
     { \
-        type **pp = lua_newuserdata(L, sizeof(type *)); \
+        type **pp; \
+        if(luaA_userdata_get(L, p)) \
+            return 1; \
+        pp = lua_newuserdata(L, sizeof(type *)); \
         *pp = p; \
         type_ref(pp); \
-        return luaA_settype(L, lua_type); \
+        luaA_settype(L, lua_type); \
+        luaA_userdata_register(L, p); \
+        return 1; \
     } \
     static int \
     luaA_##prefix##_tostring(lua_State *L) \
@@ -224,6 +235,41 @@ luaA_settype(lua_State *L, const char *type)
     return 1;
 }
 
+/** Push the canonical userdata of a C object, if it has one.
+ * \param L The Lua VM state.
+ * \param p The C object.
+ * \return True if the userdata has been pushed.
+ */
+static inline bool
+luaA_userdata_get(lua_State *L, void *p)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, LUAA_USERDATA_REGISTRY);
+    lua_pushlightuserdata(L, p);
+    lua_rawget(L, -2);
+    if(lua_isnil(L, -1))
+    {
+        lua_pop(L, 2);
+        return false;
+    }
+    lua_remove(L, -2);
+    return true;
+}
+
+/** Register the userdata on top of the stack as the canonical userdata of
+ * a C object.
+ * \param L The Lua VM state.
+ * \param p The C object.
+ */
+static inline void
+luaA_userdata_register(lua_State *L, void *p)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, LUAA_USERDATA_REGISTRY);
+    lua_pushlightuserdata(L, p);
+    lua_pushvalue(L, -3);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
 /** Push a area type to a table on stack.
  * \param L The Lua VM state.
  * \param geometry The area geometry to push.
@@ -304,28 +350,14 @@ luaA_registerfct(lua_State *L, int idx, luaA_ref *fct)
     return luaA_register(L, idx, fct);
 }
 
-/** Execute an Lua function.
- * \param L The Lua stack.
- * \param f The Lua function to execute.
- * \param nargs The number of arguments for the Lua function.
- * \param nret The number of returned value from the Lua function.
- * \return True on no error, false otherwise.
- */
-static inline bool
-luaA_dofunction(lua_State *L, luaA_ref f, int nargs, int nret)
-{
-    lua_rawgeti(L, LUA_REGISTRYINDEX, f);
-    if(nargs)
-        lua_insert(L, - (nargs + 1));
-    if(lua_pcall(L, nargs, nret, 0))
-    {
-        warn("error running function: %s",
-             lua_tostring(L, -1));
-        lua_pop(L, 1);
-        return false;
-    }
-    return true;
-}
+/** Default number of seconds a Lua call from the event loop may run. */
+#define LUAA_BUDGET_TIME 5.0
+/** Number of Lua instructions between two execution budget checks. */
+#define LUAA_BUDGET_GRANULARITY 1000
+
+int luaA_pcall(lua_State *, int, int);
+bool luaA_dofunction(lua_State *, luaA_ref, int, int);
+char *luaA_ref_name(lua_State *, luaA_ref);
 
 /** Print a warning about some Lua code.
  * This is less mean than luaL_error() which setjmp via lua_error() and kills
@@ -346,20 +378,11 @@ luaA_warn(lua_State *L, const char *fmt, ...)
     fprintf(stderr, "\n");
 }
 
-int luaA_otable_index(lua_State *);
+/** Registry key of the table of object tables, with weak keys. */
+#define LUAA_OTABLE_REGISTRY "awesome.otables"
 
-/** Create a new object table with a metatable.
- * This is useful to compare table with objects (udata) as keys.
- * \param L The Lua stack.
- * \return The number of elements pushed on stack.
- */
-static inline int
-luaA_otable_new(lua_State *L)
-{
-    /* Our object */
-    lua_newtable(L);
-    return luaA_settype(L, "otable");
-}
+int luaA_otable_new(lua_State *);
+void luaA_otable_purge(lua_State *, void *);
 
 void luaA_init(void);
 bool luaA_parserc(const char *, bool);
@@ -374,12 +397,9 @@ bool luaA_isloop(lua_State *, int);
 
 #define hooks_property(c, prop) \
     do { \
-        if(globalconf.hooks.property != LUA_REFNIL) \
-        { \
-            luaA_client_userdata_new(globalconf.L, c); \
-            lua_pushliteral(globalconf.L, prop); \
-            luaA_dofunction(globalconf.L, globalconf.hooks.property, 2, 0); \
-        } \
+        if(globalconf.hooks.property != LUA_REFNIL \
+           || globalconf.hooks.property_immediate != LUA_REFNIL) \
+            client_property_notify(c, prop); \
     } while(0);
 
 #endif
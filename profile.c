@@ -0,0 +1,280 @@
+/*
+ * profile.c - Lua profiler
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <sys/time.h>
+#include <errno.h>
+#include <math.h>
+
+#include "profile.h"
+
+volatile sig_atomic_t profile_pending;
+
+/** Profiler state */
+static struct
+{
+    /** True if the profiling timer is armed */
+    bool running;
+    /** True once the signal handler has been installed */
+    bool installed;
+    /** Seconds of CPU time between two samples */
+    double interval;
+    /** Samples taken while no Lua code was running */
+    unsigned long native;
+    /** Samples recorded */
+    unsigned long samples;
+} profile = { .interval = PROFILE_INTERVAL };
+
+static void
+profile_signal(int sig)
+{
+    profile_pending++;
+}
+
+/** Check whether the profiler is running.
+ * \return True if samples are being taken.
+ */
+bool
+profile_running(void)
+{
+    return profile.running;
+}
+
+/** Arm the profiling timer.
+ * \param interval Seconds of CPU time between two samples.
+ * \return True on success.
+ */
+static bool
+profile_timer_set(double interval)
+{
+    struct itimerval it;
+
+    it.it_interval.tv_sec = interval;
+    it.it_interval.tv_usec = fmod(interval, 1) * 1000000;
+    it.it_value = it.it_interval;
+
+    return setitimer(ITIMER_PROF, &it, NULL) == 0;
+}
+
+/** Start the profiler, discarding previous samples.
+ * \param L The Lua VM state.
+ * \param interval Seconds of CPU time between two samples.
+ * \return True on success.
+ */
+bool
+profile_start(lua_State *L, double interval)
+{
+    if(!profile.installed)
+    {
+        struct sigaction sa;
+
+        /* the handler stays installed once the timer is stopped, since a
+         * signal may already be on its way */
+        sa.sa_handler = profile_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if(sigaction(SIGPROF, &sa, NULL))
+        {
+            warn("cannot install profiling signal handler: %s", strerror(errno));
+            return false;
+        }
+        profile.installed = true;
+    }
+
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, PROFILE_REGISTRY);
+    profile.native = profile.samples = 0;
+    profile_pending = 0;
+
+    if(!profile_timer_set(MAX(interval, 0.000001)))
+    {
+        warn("cannot start profiling timer: %s", strerror(errno));
+        return false;
+    }
+
+    profile.interval = interval;
+    profile.running = true;
+
+    return true;
+}
+
+/** Stop the profiler, keeping its samples.
+ */
+void
+profile_stop(void)
+{
+    if(!profile.running)
+        return;
+
+    profile_timer_set(0);
+    profile_idle();
+    profile.running = false;
+}
+
+/** Account pending samples to code running outside Lua.
+ * This is called before any Lua code runs from the event loop.
+ */
+void
+profile_idle(void)
+{
+    if(profile.running)
+        profile.native += profile_pending;
+    profile_pending = 0;
+}
+
+/** Append a Lua stack frame to a folded stack.
+ * \param buf The buffer holding the folded stack.
+ * \param ar The frame.
+ */
+static void
+profile_frame_add(buffer_t *buf, lua_Debug *ar)
+{
+    buffer_addc(buf, ';');
+    if(*ar->what == 'C')
+        buffer_addf(buf, "%s [C]", ar->name ? ar->name : "?");
+    else if(*ar->what == 'm')
+        buffer_addf(buf, "main %s", ar->short_src);
+    else if(ar->name)
+        buffer_addf(buf, "%s %s:%d", ar->name, ar->short_src, ar->linedefined);
+    else
+        buffer_addf(buf, "%s:%d", ar->short_src, ar->linedefined);
+}
+
+/** Record pending samples against the current Lua stack.
+ * This is called from the Lua count hook.
+ * \param L The Lua VM state.
+ * \param root The name of the callback being run, or NULL.
+ */
+void
+profile_sample(lua_State *L, const char *root)
+{
+    lua_Debug ar[PROFILE_DEPTH_MAX];
+    int depth, count = profile_pending;
+    buffer_t buf;
+
+    profile_pending = 0;
+
+    if(!profile.running || count <= 0)
+        return;
+
+    for(depth = 0; depth < PROFILE_DEPTH_MAX && lua_getstack(L, depth, &ar[depth]); depth++);
+
+    buffer_init(&buf);
+    buffer_adds(&buf, root ? root : "lua");
+    /* outermost frame first, as expected by flame graph tools */
+    while(depth--)
+    {
+        lua_getinfo(L, "Sn", &ar[depth]);
+        profile_frame_add(&buf, &ar[depth]);
+    }
+
+    lua_getfield(L, LUA_REGISTRYINDEX, PROFILE_REGISTRY);
+    lua_pushlstring(L, buf.s, buf.len);
+    lua_pushvalue(L, -1);
+    lua_rawget(L, -3);
+    lua_pushnumber(L, lua_tonumber(L, -1) + count);
+    lua_remove(L, -2);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    profile.samples += count;
+
+    buffer_wipe(&buf);
+}
+
+/** Dump the samples as folded stacks, one `frame;frame;frame count' line
+ * per distinct stack.
+ * \param L The Lua VM state.
+ * \param buf The buffer to append the stacks to.
+ */
+void
+profile_dump(lua_State *L, buffer_t *buf)
+{
+    if(profile.running)
+        profile_idle();
+
+    lua_getfield(L, LUA_REGISTRYINDEX, PROFILE_REGISTRY);
+    if(lua_istable(L, -1))
+    {
+        lua_pushnil(L);
+        while(lua_next(L, -2))
+        {
+            buffer_addf(buf, "%s %.0f\n", lua_tostring(L, -2), lua_tonumber(L, -1));
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+
+    if(profile.native)
+        buffer_addf(buf, "awesome %lu\n", profile.native);
+}
+
+/** Start the Lua profiler, discarding previous samples.
+ * Samples are taken every interval of CPU time used by awesome, and counted
+ * against the hook or callback being run and its Lua stack.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam An optional number of seconds of CPU time between two samples.
+ * \lreturn True if the profiler has been started.
+ */
+int
+luaA_profile_start(lua_State *L)
+{
+    lua_pushboolean(L, profile_start(L, luaL_optnumber(L, 1, profile.interval)));
+    return 1;
+}
+
+/** Stop the Lua profiler, keeping its samples.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn The number of samples taken.
+ */
+int
+luaA_profile_stop(lua_State *L)
+{
+    profile_stop();
+    lua_pushnumber(L, profile.samples + profile.native);
+    return 1;
+}
+
+/** Dump the Lua profiler samples as folded stacks, suitable for flame graph
+ * tools. Samples taken while no Lua code was running are counted against
+ * `awesome'.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn A string with one `frame;frame;frame count' line per stack.
+ */
+int
+luaA_profile_dump(lua_State *L)
+{
+    buffer_t buf;
+
+    buffer_init(&buf);
+    profile_dump(L, &buf);
+    lua_pushlstring(L, buf.s, buf.len);
+    buffer_wipe(&buf);
+
+    return 1;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -0,0 +1,54 @@
+/*
+ * profile.h - Lua profiler header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_PROFILE_H
+#define AWESOME_PROFILE_H
+
+#include <signal.h>
+
+#include "luaa.h"
+#include "common/buffer.h"
+
+/** Default number of seconds of CPU time between two samples. */
+#define PROFILE_INTERVAL 0.001
+/** Number of Lua instructions between two checks for a pending sample. */
+#define PROFILE_GRANULARITY 100
+/** Maximum number of Lua stack frames recorded per sample. */
+#define PROFILE_DEPTH_MAX 64
+/** Registry key of the table of sample counts by folded stack. */
+#define PROFILE_REGISTRY "awesome.profile"
+
+/** Number of samples taken by the profiling signal and not recorded yet. */
+extern volatile sig_atomic_t profile_pending;
+
+bool profile_running(void);
+bool profile_start(lua_State *, double);
+void profile_stop(void);
+void profile_idle(void);
+void profile_sample(lua_State *, const char *);
+void profile_dump(lua_State *, buffer_t *);
+
+int luaA_profile_start(lua_State *);
+int luaA_profile_stop(lua_State *);
+int luaA_profile_dump(lua_State *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
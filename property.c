@@ -188,7 +188,7 @@ property_update_wm_hints(client_t *c, xcb_get_property_reply_t *reply)
     {
         c->isurgent = isurgent;
         /* execute hook */
-        hooks_property(c, "urgent");
+        hooks_property(c, CLIENT_PROPERTY_URGENT);
     }
     if(wmh.flags & XCB_WM_HINT_STATE &&
        wmh.initial_state == XCB_WM_STATE_WITHDRAWN)
@@ -236,7 +236,7 @@ property_update_wm_name(client_t *c)
         c->name = name;
 
     /* call hook */
-    hooks_property(c, "name");
+    hooks_property(c, CLIENT_PROPERTY_NAME);
 }
 
 /** Update client icon name attribute with its new title.
@@ -261,7 +261,7 @@ property_update_wm_icon_name(client_t *c)
         c->icon_name = name;
 
     /* call hook */
-    hooks_property(c, "icon_name");
+    hooks_property(c, CLIENT_PROPERTY_ICON_NAME);
 }
 
 static int
@@ -322,16 +322,9 @@ property_handle_net_wm_icon(void *data,
 {
     client_t *c = client_getbywin(window);
 
-    if(c)
-    {
-        image_t *icon;
-        image_unref(&c->icon);
-        icon = ewmh_window_icon_from_reply(reply);
-        c->icon = icon ? image_ref(&icon) : NULL;
-
+    if(c && ewmh_client_icon_update(c, reply))
         /* execute hook */
-        hooks_property(c, "icon");
-    }
+        hooks_property(c, CLIENT_PROPERTY_ICON);
 
     return 0;
 }
@@ -0,0 +1,637 @@
+/*
+ * sampler.c - system metrics sampler
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "structs.h"
+#include "sampler.h"
+#include "common/tokenize.h"
+
+extern awesome_t globalconf;
+
+DO_LUA_NEW(static, sampler_t, sampler, "sampler", sampler_ref)
+DO_LUA_GC(sampler_t, sampler, "sampler", sampler_unref)
+DO_LUA_EQ(sampler_t, sampler, "sampler")
+
+/** Sampler type names, in sampler_type_t order. */
+static const char * const sampler_types[] =
+{
+    "cpu", "memory", "net", "battery", "thermal",
+};
+
+/** Names of the values of each sampler type. */
+static const char * const sampler_fields[][SAMPLER_FIELDS_MAX] =
+{
+    [SAMPLER_CPU]     = { "usage", "iowait" },
+    [SAMPLER_MEMORY]  = { "used", "swap" },
+    [SAMPLER_NET]     = { "rx", "tx" },
+    [SAMPLER_BATTERY] = { "capacity", NULL },
+    [SAMPLER_THERMAL] = { "temp", NULL },
+};
+
+/** Delete a sampler.
+ * \param s The sampler to delete.
+ */
+void
+sampler_delete(sampler_t **s)
+{
+    close((*s)->fd);
+    sampler_binding_array_wipe(&(*s)->bindings);
+    p_delete(&(*s)->key);
+    p_delete(s);
+}
+
+/** Find a line starting with a key, leading blanks ignored.
+ * \param p The buffer.
+ * \param end The buffer end.
+ * \param key The key.
+ * \param len The key length.
+ * \return A pointer right after the key, or NULL if not found.
+ */
+static const char *
+sampler_line_find(const char *p, const char *end, const char *key, ssize_t len)
+{
+    while(p < end)
+    {
+        const char *line = p;
+
+        while(line < end && *line == ' ')
+            line++;
+        if(end - line >= len && !memcmp(line, key, len))
+            return line + len;
+        if(!(p = memchr(p, '\n', end - p)))
+            break;
+        p++;
+    }
+    return NULL;
+}
+
+/** Scan an unsigned decimal number, leading blanks ignored.
+ * \param p The buffer.
+ * \param end The buffer end.
+ * \param v The number scanned, 0 if there is none.
+ * \return A pointer right after the number.
+ */
+static const char *
+sampler_scan_u64(const char *p, const char *end, uint64_t *v)
+{
+    uint64_t n = 0;
+
+    while(p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    while(p < end && *p >= '0' && *p <= '9')
+        n = n * 10 + (*p++ - '0');
+    *v = n;
+    return p;
+}
+
+/** Get the value following a key in a file like /proc/meminfo.
+ * \param buf The buffer.
+ * \param end The buffer end.
+ * \param key The key.
+ * \param v The value.
+ * \return True if the key has been found.
+ */
+static bool
+sampler_scan_field(const char *buf, const char *end, const char *key, uint64_t *v)
+{
+    const char *p = sampler_line_find(buf, end, key, a_strlen(key));
+
+    if(!p)
+        return false;
+    sampler_scan_u64(p, end, v);
+    return true;
+}
+
+/** Counter difference, with resets giving 0.
+ * \param cur The current value.
+ * \param prev The previous value.
+ * \return The difference.
+ */
+static inline uint64_t
+sampler_delta(uint64_t cur, uint64_t prev)
+{
+    return cur > prev ? cur - prev : 0;
+}
+
+static bool
+sampler_parse_cpu(sampler_t *s, const char *buf, const char *end)
+{
+    uint64_t v, total = 0, idle = 0, iowait = 0;
+    const char *p;
+    bool ok = false;
+
+    if(!(p = sampler_line_find(buf, end, s->key, s->key_len)))
+        return false;
+
+    /* user nice system idle iowait irq softirq steal */
+    for(int i = 0; i < 8; i++)
+    {
+        p = sampler_scan_u64(p, end, &v);
+        total += v;
+        if(i == 3)
+            idle = v;
+        else if(i == 4)
+            iowait = v;
+    }
+
+    if(s->has_prev && total > s->prev[0])
+    {
+        double dtotal = total - s->prev[0];
+        double didle = sampler_delta(idle, s->prev[1]);
+        double diowait = sampler_delta(iowait, s->prev[2]);
+
+        s->values[0] = MAX(0, 100 * (dtotal - didle - diowait) / dtotal);
+        s->values[1] = MIN(100, 100 * diowait / dtotal);
+        ok = true;
+    }
+
+    s->prev[0] = total;
+    s->prev[1] = idle;
+    s->prev[2] = iowait;
+    s->has_prev = true;
+    return ok;
+}
+
+static bool
+sampler_parse_memory(sampler_t *s, const char *buf, const char *end)
+{
+    uint64_t total, available, mem_free = 0, buffers = 0, cached = 0;
+    uint64_t swap_total, swap_free;
+
+    if(!sampler_scan_field(buf, end, "MemTotal:", &total) || !total)
+        return false;
+
+    if(!sampler_scan_field(buf, end, "MemAvailable:", &available))
+    {
+        sampler_scan_field(buf, end, "MemFree:", &mem_free);
+        sampler_scan_field(buf, end, "Buffers:", &buffers);
+        sampler_scan_field(buf, end, "Cached:", &cached);
+        available = mem_free + buffers + cached;
+    }
+
+    s->values[0] = 100. * sampler_delta(total, available) / total;
+
+    if(sampler_scan_field(buf, end, "SwapTotal:", &swap_total) && swap_total
+       && sampler_scan_field(buf, end, "SwapFree:", &swap_free))
+        s->values[1] = 100. * sampler_delta(swap_total, swap_free) / swap_total;
+    else
+        s->values[1] = 0;
+
+    return true;
+}
+
+static bool
+sampler_parse_net(sampler_t *s, const char *buf, const char *end)
+{
+    uint64_t v, rx = 0, tx = 0;
+    ev_tstamp now = ev_now(globalconf.loop);
+    const char *p;
+    bool ok = false;
+
+    if(!(p = sampler_line_find(buf, end, s->key, s->key_len)))
+        return false;
+
+    /* 8 receive counters, then 8 transmit counters */
+    for(int i = 0; i < 9; i++)
+    {
+        p = sampler_scan_u64(p, end, &v);
+        if(i == 0)
+            rx = v;
+        else if(i == 8)
+            tx = v;
+    }
+
+    if(s->has_prev && now > s->prev_time)
+    {
+        s->values[0] = sampler_delta(rx, s->prev[0]) / (now - s->prev_time);
+        s->values[1] = sampler_delta(tx, s->prev[1]) / (now - s->prev_time);
+        ok = true;
+    }
+
+    s->prev[0] = rx;
+    s->prev[1] = tx;
+    s->prev_time = now;
+    s->has_prev = true;
+    return ok;
+}
+
+static bool
+sampler_parse_number(sampler_t *s, const char *buf, const char *end, float scale)
+{
+    uint64_t v;
+    bool negative = buf < end && *buf == '-';
+    const char *p = sampler_scan_u64(buf + negative, end, &v);
+
+    if(p == buf + negative)
+        return false;
+
+    s->values[0] = (negative ? -(float) v : (float) v) / scale;
+    return true;
+}
+
+/** Read the sampled file, compute values and feed the bound time series.
+ * \param s The sampler.
+ */
+static void
+sampler_sample(sampler_t *s)
+{
+    static char buf[SAMPLER_READ_MAX];
+    ssize_t len = pread(s->fd, buf, sizeof(buf), 0);
+    const char *end = buf + len;
+    bool ok = false;
+
+    if(len <= 0)
+        return;
+
+    switch(s->type)
+    {
+      case SAMPLER_CPU:
+        ok = sampler_parse_cpu(s, buf, end);
+        break;
+      case SAMPLER_MEMORY:
+        ok = sampler_parse_memory(s, buf, end);
+        break;
+      case SAMPLER_NET:
+        ok = sampler_parse_net(s, buf, end);
+        break;
+      case SAMPLER_BATTERY:
+        ok = sampler_parse_number(s, buf, end, 1);
+        break;
+      case SAMPLER_THERMAL:
+        ok = sampler_parse_number(s, buf, end, 1000);
+        break;
+    }
+
+    if(!ok)
+        return;
+
+    s->has_values = true;
+    for(int i = 0; i < s->bindings.len; i++)
+        timeseries_push(s->bindings.tab[i].ts, s->values[s->bindings.tab[i].field]);
+}
+
+static void
+sampler_cb(EV_P_ ev_timer *w, int revents)
+{
+    sampler_sample(w->data);
+}
+
+/** Start a sampler. A running sampler keeps a reference to itself.
+ * \param s The sampler.
+ */
+static void
+sampler_start(sampler_t *s)
+{
+    if(s->started)
+        return;
+    s->started = true;
+    sampler_ref(&s);
+    ev_timer_again(globalconf.loop, &s->timer);
+}
+
+/** Stop a sampler.
+ * \param s The sampler.
+ */
+static void
+sampler_stop(sampler_t *s)
+{
+    if(!s->started)
+        return;
+    ev_timer_stop(globalconf.loop, &s->timer);
+    s->started = false;
+    sampler_unref(&s);
+}
+
+/** Get the index of a sampler value from its name.
+ * \param L The Lua VM state.
+ * \param s The sampler.
+ * \param idx The name index.
+ * \return The value index.
+ */
+static int
+luaA_sampler_checkfield(lua_State *L, sampler_t *s, int idx)
+{
+    const char *name = luaL_checkstring(L, idx);
+
+    for(int i = 0; i < SAMPLER_FIELDS_MAX; i++)
+        if(!a_strcmp(sampler_fields[s->type][i], name))
+            return i;
+
+    return luaL_error(L, "unknown %s sampler value: %s", sampler_types[s->type], name);
+}
+
+/** Create a new sampler, and start it.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam What to sample: `cpu' for usage and iowait percentages, `memory'
+ * for used memory and swap percentages, `net' for rx and tx rates in bytes per
+ * second, `battery' for capacity percentage, or `thermal' for temp in degrees
+ * Celsius.
+ * \lparam The number of seconds between two samples.
+ * \lparam An optional table with `cpu', a CPU number, `interface', a network
+ * interface name, `name', a power supply name, or `zone', a thermal zone
+ * number.
+ * \lreturn A brand new sampler, or nil if the file to sample cannot be opened.
+ */
+static int
+luaA_sampler_new(lua_State *L)
+{
+    const char *kind = luaL_checkstring(L, 2);
+    double interval = luaL_checknumber(L, 3);
+    char path[128], key[64];
+    sampler_type_t type;
+    sampler_t *s;
+    int i, fd;
+
+    for(i = 0; i < countof(sampler_types); i++)
+        if(!a_strcmp(sampler_types[i], kind))
+            break;
+    if(i == countof(sampler_types))
+        luaL_error(L, "unknown sampler type: %s", kind);
+    type = i;
+
+    if(interval <= 0)
+        luaL_error(L, "invalid sampler interval: %f", interval);
+
+    if(lua_gettop(L) >= 4)
+        luaA_checktable(L, 4);
+
+    key[0] = '\0';
+    switch(type)
+    {
+      case SAMPLER_CPU:
+        a_strcpy(path, sizeof(path), "/proc/stat");
+        if(lua_gettop(L) >= 4 && (i = luaA_getopt_number(L, 4, "cpu", -1)) >= 0)
+            snprintf(key, sizeof(key), "cpu%d ", i);
+        else
+            a_strcpy(key, sizeof(key), "cpu ");
+        break;
+      case SAMPLER_MEMORY:
+        a_strcpy(path, sizeof(path), "/proc/meminfo");
+        break;
+      case SAMPLER_NET:
+        a_strcpy(path, sizeof(path), "/proc/net/dev");
+        if(lua_gettop(L) < 4 || !luaA_getopt_string(L, 4, "interface", NULL))
+            luaL_error(L, "net sampler needs an interface");
+        snprintf(key, sizeof(key), "%s:", lua_tostring(L, -1));
+        break;
+      case SAMPLER_BATTERY:
+        snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity",
+                 lua_gettop(L) >= 4 ? luaA_getopt_string(L, 4, "name", "BAT0") : "BAT0");
+        break;
+      case SAMPLER_THERMAL:
+        snprintf(path, sizeof(path), "/sys/class/thermal/thermal_zone%d/temp",
+                 lua_gettop(L) >= 4 ? (int) luaA_getopt_number(L, 4, "zone", 0) : 0);
+        break;
+    }
+
+    if((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        luaA_warn(L, "cannot open %s: %s", path, strerror(errno));
+        return 0;
+    }
+
+    s = p_new(sampler_t, 1);
+    s->type = type;
+    s->fd = fd;
+    s->key = a_strdup(key);
+    s->key_len = a_strlen(key);
+    ev_init(&s->timer, sampler_cb);
+    s->timer.repeat = interval;
+    s->timer.data = s;
+
+    /* read counters now, so that the first tick has deltas */
+    sampler_sample(s);
+    sampler_start(s);
+
+    return luaA_sampler_userdata_new(L, s);
+}
+
+/** Start a sampler.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A sampler.
+ */
+static int
+luaA_sampler_start(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    sampler_start(*s);
+    return 0;
+}
+
+/** Stop a sampler.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A sampler.
+ */
+static int
+luaA_sampler_stop(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    sampler_stop(*s);
+    return 0;
+}
+
+/** Sample now, without waiting for the next tick.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A sampler.
+ */
+static int
+luaA_sampler_sample(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    sampler_sample(*s);
+    return 0;
+}
+
+/** Feed a time series with one of the values of a sampler.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A sampler.
+ * \lparam A value name.
+ * \lparam A time series.
+ */
+static int
+luaA_sampler_bind(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    int field = luaA_sampler_checkfield(L, *s, 2);
+    timeseries_t **ts = luaA_checkudata(L, 3, "timeseries");
+    sampler_binding_t binding;
+
+    for(int i = 0; i < (*s)->bindings.len; i++)
+        if((*s)->bindings.tab[i].field == field && (*s)->bindings.tab[i].ts == *ts)
+            return 0;
+
+    binding.field = field;
+    binding.ts = timeseries_ref(ts);
+    sampler_binding_array_append(&(*s)->bindings, binding);
+
+    return 0;
+}
+
+/** Stop feeding a time series with one of the values of a sampler.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A sampler.
+ * \lparam A value name.
+ * \lparam A time series.
+ */
+static int
+luaA_sampler_unbind(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    int field = luaA_sampler_checkfield(L, *s, 2);
+    timeseries_t **ts = luaA_checkudata(L, 3, "timeseries");
+
+    for(int i = 0; i < (*s)->bindings.len; i++)
+        if((*s)->bindings.tab[i].field == field && (*s)->bindings.tab[i].ts == *ts)
+        {
+            sampler_binding_t binding = sampler_binding_array_take(&(*s)->bindings, i);
+            sampler_binding_wipe(&binding);
+            break;
+        }
+
+    return 0;
+}
+
+/** Get the last values of a sampler.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A sampler.
+ * \lreturn A table with the last values by name, empty until computed.
+ */
+static int
+luaA_sampler_query(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+
+    lua_newtable(L);
+
+    if((*s)->has_values)
+        for(int i = 0; i < SAMPLER_FIELDS_MAX; i++)
+            if(sampler_fields[(*s)->type][i])
+            {
+                lua_pushnumber(L, (*s)->values[i]);
+                lua_setfield(L, -2, sampler_fields[(*s)->type][i]);
+            }
+
+    return 1;
+}
+
+/** Sampler object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lfield interval The number of seconds between two samples.
+ * \lfield type What is sampled, read-only.
+ * \lfield started True if the sampler is running, read-only.
+ */
+static int
+luaA_sampler_index(lua_State *L)
+{
+    if(luaA_usemetatable(L, 1, 2))
+        return 1;
+
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_INTERVAL:
+        lua_pushnumber(L, (*s)->timer.repeat);
+        break;
+      case A_TK_TYPE:
+        lua_pushstring(L, sampler_types[(*s)->type]);
+        break;
+      case A_TK_STARTED:
+        lua_pushboolean(L, (*s)->started);
+        break;
+      default:
+        return 0;
+    }
+
+    return 1;
+}
+
+/** Sampler object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_sampler_newindex(lua_State *L)
+{
+    sampler_t **s = luaA_checkudata(L, 1, "sampler");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+    double interval;
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_INTERVAL:
+        if((interval = luaL_checknumber(L, 3)) <= 0)
+            luaL_error(L, "invalid sampler interval: %f", interval);
+        (*s)->timer.repeat = interval;
+        if((*s)->started)
+            ev_timer_again(globalconf.loop, &(*s)->timer);
+        break;
+      default:
+        break;
+    }
+
+    return 0;
+}
+
+const struct luaL_reg awesome_sampler_methods[] =
+{
+    { "__call", luaA_sampler_new },
+    { NULL, NULL }
+};
+const struct luaL_reg awesome_sampler_meta[] =
+{
+    { "start", luaA_sampler_start },
+    { "stop", luaA_sampler_stop },
+    { "bind", luaA_sampler_bind },
+    { "unbind", luaA_sampler_unbind },
+    { "query", luaA_sampler_query },
+    { "sample", luaA_sampler_sample },
+    { "__index", luaA_sampler_index },
+    { "__newindex", luaA_sampler_newindex },
+    { "__gc", luaA_sampler_gc },
+    { "__eq", luaA_sampler_eq },
+    { "__tostring", luaA_sampler_tostring },
+    { NULL, NULL }
+};
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -0,0 +1,97 @@
+/*
+ * sampler.h - system metrics sampler header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_SAMPLER_H
+#define AWESOME_SAMPLER_H
+
+#include <stdint.h>
+
+#include <ev.h>
+
+#include "timeseries.h"
+
+/** Maximum number of values a sampler produces. */
+#define SAMPLER_FIELDS_MAX 2
+/** Maximum number of bytes read from a sampled file. */
+#define SAMPLER_READ_MAX 16384
+
+/** What a sampler reads */
+typedef enum
+{
+    SAMPLER_CPU = 0,
+    SAMPLER_MEMORY,
+    SAMPLER_NET,
+    SAMPLER_BATTERY,
+    SAMPLER_THERMAL
+} sampler_type_t;
+
+/** A time series fed with one of the values of a sampler */
+typedef struct
+{
+    /** The value index */
+    int field;
+    /** The time series */
+    timeseries_t *ts;
+} sampler_binding_t;
+
+static inline void
+sampler_binding_wipe(sampler_binding_t *binding)
+{
+    timeseries_unref(&binding->ts);
+}
+
+DO_ARRAY(sampler_binding_t, sampler_binding, sampler_binding_wipe)
+
+typedef struct
+{
+    /** Ref count */
+    int refcount;
+    /** What is sampled */
+    sampler_type_t type;
+    /** The sampled file, kept open */
+    int fd;
+    /** The line to look for, like "cpu2 " or "eth0:" */
+    char *key;
+    ssize_t key_len;
+    /** Sampling timer */
+    struct ev_timer timer;
+    /** True if the sampler is running */
+    bool started;
+    /** Counters of the previous sample, for deltas */
+    uint64_t prev[3];
+    /** Time of the previous sample, for rates */
+    ev_tstamp prev_time;
+    /** True once counters have been read */
+    bool has_prev;
+    /** Last values */
+    float values[SAMPLER_FIELDS_MAX];
+    /** True once values have been computed */
+    bool has_values;
+    /** Time series fed by this sampler */
+    sampler_binding_array_t bindings;
+} sampler_t;
+
+void sampler_delete(sampler_t **);
+
+DO_RCNT(sampler_t, sampler, sampler_delete)
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
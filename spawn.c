@@ -0,0 +1,443 @@
+/*
+ * spawn.c - process spawning
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <ev.h>
+
+#include <xcb/xcb.h>
+
+#include "structs.h"
+#include "spawn.h"
+#include "common/buffer.h"
+#include "common/list.h"
+
+extern awesome_t globalconf;
+
+/** An output pipe of a watched child */
+typedef struct
+{
+    /** The watcher, with fd -1 once the pipe is closed */
+    ev_io io;
+    /** Data read but not delivered yet */
+    buffer_t buf;
+    /** Lua function to call with output */
+    luaA_ref fct;
+} spawn_pipe_t;
+
+/** A watched child */
+typedef struct spawn_child_t spawn_child_t;
+struct spawn_child_t
+{
+    /** Process id */
+    pid_t pid;
+    /** Exit watcher */
+    ev_child child;
+    /** Standard output and error */
+    spawn_pipe_t out, err;
+    /** Kill timer */
+    ev_timer timeout;
+    /** Lua function to call on exit */
+    luaA_ref exit;
+    /** Deliver output by lines, or by chunks */
+    bool lines;
+    /** True once the child has exited */
+    bool exited;
+    /** Exit status, as returned by waitpid() */
+    int status;
+    /** Next and previous children */
+    spawn_child_t *prev, *next;
+};
+
+static void
+spawn_child_delete(spawn_child_t **child)
+{
+    luaA_unregister(globalconf.L, &(*child)->out.fct);
+    luaA_unregister(globalconf.L, &(*child)->err.fct);
+    luaA_unregister(globalconf.L, &(*child)->exit);
+    buffer_wipe(&(*child)->out.buf);
+    buffer_wipe(&(*child)->err.buf);
+    p_delete(child);
+}
+
+DO_SLIST(spawn_child_t, spawn_child, spawn_child_delete)
+
+/** Watched children */
+static spawn_child_t *spawn_children;
+static int spawn_children_len;
+
+/** Call the function of a pipe with some output.
+ * \param sp The pipe.
+ * \param data The output.
+ * \param len The output length.
+ */
+static void
+spawn_pipe_deliver(spawn_pipe_t *sp, const char *data, int len)
+{
+    if(sp->fct == LUA_REFNIL)
+        return;
+    lua_pushlstring(globalconf.L, data, len);
+    luaA_dofunction(globalconf.L, sp->fct, 1, 0);
+}
+
+/** Deliver the buffered output of a pipe.
+ * \param child The child.
+ * \param sp The pipe.
+ * \param eof True if nothing more will be read, to flush the last line.
+ */
+static void
+spawn_pipe_flush(spawn_child_t *child, spawn_pipe_t *sp, bool eof)
+{
+    if(!child->lines)
+    {
+        if(sp->buf.len)
+            spawn_pipe_deliver(sp, sp->buf.s, sp->buf.len);
+        buffer_splice(&sp->buf, 0, sp->buf.len, NULL, 0);
+        return;
+    }
+
+    int start = 0;
+    char *nl;
+
+    while((nl = memchr(sp->buf.s + start, '\n', sp->buf.len - start)))
+    {
+        spawn_pipe_deliver(sp, sp->buf.s + start, nl - (sp->buf.s + start));
+        start = nl - sp->buf.s + 1;
+    }
+
+    if(eof && start < sp->buf.len)
+    {
+        spawn_pipe_deliver(sp, sp->buf.s + start, sp->buf.len - start);
+        start = sp->buf.len;
+    }
+
+    buffer_splice(&sp->buf, 0, start, NULL, 0);
+}
+
+/** Close the read end of a pipe.
+ * \param sp The pipe.
+ */
+static void
+spawn_pipe_close(spawn_pipe_t *sp)
+{
+    if(sp->io.fd < 0)
+        return;
+    ev_io_stop(globalconf.loop, &sp->io);
+    close(sp->io.fd);
+    sp->io.fd = -1;
+}
+
+/** Finish with a child once it has exited and its pipes are closed.
+ * \param child The child.
+ */
+static void
+spawn_child_finish(spawn_child_t *child)
+{
+    if(!child->exited || child->out.io.fd >= 0 || child->err.io.fd >= 0)
+        return;
+
+    ev_timer_stop(globalconf.loop, &child->timeout);
+    spawn_child_list_detach(&spawn_children, child);
+    spawn_children_len--;
+
+    if(child->exit != LUA_REFNIL)
+    {
+        if(WIFEXITED(child->status))
+        {
+            lua_pushnumber(globalconf.L, WEXITSTATUS(child->status));
+            lua_pushnil(globalconf.L);
+        }
+        else
+        {
+            lua_pushnil(globalconf.L);
+            lua_pushnumber(globalconf.L, WTERMSIG(child->status));
+        }
+        luaA_dofunction(globalconf.L, child->exit, 2, 0);
+    }
+
+    spawn_child_delete(&child);
+}
+
+static void
+spawn_pipe_cb(EV_P_ ev_io *w, int revents)
+{
+    spawn_child_t *child = w->data;
+    spawn_pipe_t *sp = w == &child->out.io ? &child->out : &child->err;
+    char buf[4096];
+    ssize_t len;
+
+    while((len = read(w->fd, buf, sizeof(buf))) > 0)
+        buffer_add(&sp->buf, buf, len);
+
+    if(len < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        spawn_pipe_flush(child, sp, false);
+        return;
+    }
+
+    spawn_pipe_close(sp);
+    spawn_pipe_flush(child, sp, true);
+    spawn_child_finish(child);
+}
+
+static void
+spawn_child_cb(EV_P_ ev_child *w, int revents)
+{
+    spawn_child_t *child = w->data;
+
+    ev_child_stop(EV_A_ w);
+    child->exited = true;
+    child->status = w->rstatus;
+    spawn_child_finish(child);
+}
+
+static void
+spawn_timeout_cb(EV_P_ ev_timer *w, int revents)
+{
+    spawn_child_t *child = w->data;
+
+    /* the child leads its own session: kill the whole process group */
+    kill(-child->pid, SIGTERM);
+}
+
+/** Open a pipe whose read end is kept by awesome.
+ * \param fds The pipe file descriptors.
+ * \return True on success.
+ */
+static bool
+spawn_pipe_open(int fds[2])
+{
+    if(pipe(fds))
+        return false;
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+/** Fork and execute a command.
+ * \param cmd The command.
+ * \param out The write end of the standard output pipe, or -1.
+ * \param err The write end of the standard error pipe, or -1.
+ * \return The child pid, or -1 on error.
+ */
+static pid_t
+spawn_fork(const char *cmd, int out, int err)
+{
+    pid_t pid = fork();
+
+    if(pid == 0)
+    {
+        if(globalconf.connection)
+            xcb_disconnect(globalconf.connection);
+        if(out >= 0)
+            dup2(out, STDOUT_FILENO);
+        if(err >= 0)
+            dup2(err, STDERR_FILENO);
+        setsid();
+        a_exec(cmd);
+        warn("execl '%s' failed: %s\n", cmd, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
+/** Set up an output pipe of a child.
+ * \param L The Lua VM state.
+ * \param child The child.
+ * \param sp The pipe.
+ * \param fd The read end of the pipe, or -1.
+ * \param idx The options table index.
+ * \param name The option name of the pipe function.
+ */
+static void
+spawn_pipe_init(lua_State *L, spawn_child_t *child, spawn_pipe_t *sp,
+                int fd, int idx, const char *name)
+{
+    sp->fct = LUA_REFNIL;
+    buffer_init(&sp->buf);
+    ev_io_init(&sp->io, spawn_pipe_cb, fd, EV_READ);
+    sp->io.data = child;
+    if(fd >= 0)
+    {
+        lua_getfield(L, idx, name);
+        luaA_registerfct(L, -1, &sp->fct);
+        lua_pop(L, 1);
+        ev_io_start(globalconf.loop, &sp->io);
+    }
+}
+
+/** Spawn a program.
+ * This function is multi-head (Zaphod) aware and will set display to
+ * the right screen according to mouse position.
+ * The program is not waited for: its output and exit status can be
+ * delivered to Lua functions given in the options table.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack
+ * \luastack
+ * \lparam The command to launch.
+ * \lparam The optional screen number to spawn the command on.
+ * \lparam An optional table with `stdout' and `stderr', functions called with
+ * each line of output, `exit', a function called with the exit code, or nil
+ * and the signal number that killed the program, `lines', false to get output
+ * by chunks instead of lines, and `timeout', a number of seconds after which
+ * the program is terminated.
+ * \lreturn The program process id.
+ */
+int
+luaA_spawn(lua_State *L)
+{
+    char *host, newdisplay[128];
+    const char *cmd;
+    int screen = 0, screenp, displayp;
+    int out[2] = { -1, -1 }, err[2] = { -1, -1 };
+    spawn_child_t *child;
+    double timeout;
+    pid_t pid;
+
+    if(lua_gettop(L) >= 2 && !lua_isnil(L, 2))
+    {
+        screen = luaL_checknumber(L, 2) - 1;
+        luaA_checkscreen(screen);
+    }
+
+    cmd = luaL_checkstring(L, 1);
+
+    if(lua_gettop(L) >= 3)
+        luaA_checktable(L, 3);
+
+    if(!globalconf.xinerama_is_active)
+    {
+        xcb_parse_display(NULL, &host, &displayp, &screenp);
+        snprintf(newdisplay, sizeof(newdisplay), "%s:%d.%d", host, displayp, screen);
+        setenv("DISPLAY", newdisplay, 1);
+        p_delete(&host);
+    }
+
+    /* Nothing to watch: the default loop reaps the child for us. */
+    if(lua_gettop(L) < 3)
+    {
+        if((pid = spawn_fork(cmd, -1, -1)) < 0)
+        {
+            luaA_warn(L, "fork '%s' failed: %s", cmd, strerror(errno));
+            return 0;
+        }
+        lua_pushnumber(L, pid);
+        return 1;
+    }
+
+    if(spawn_children_len >= SPAWN_CHILDREN_MAX)
+    {
+        luaA_warn(L, "too many children, not spawning '%s'", cmd);
+        return 0;
+    }
+
+    /* check functions before forking */
+    lua_getfield(L, 3, "stdout");
+    lua_getfield(L, 3, "stderr");
+    lua_getfield(L, 3, "exit");
+    for(int i = -3; i < 0; i++)
+        if(!lua_isnil(L, i))
+            luaA_checkfunction(L, i);
+
+    if(!lua_isnil(L, -3) && !spawn_pipe_open(out))
+        luaA_warn(L, "unable to create pipe: %s", strerror(errno));
+    if(!lua_isnil(L, -2) && !spawn_pipe_open(err))
+        luaA_warn(L, "unable to create pipe: %s", strerror(errno));
+    lua_pop(L, 3);
+
+    if((pid = spawn_fork(cmd, out[1], err[1])) < 0)
+    {
+        luaA_warn(L, "fork '%s' failed: %s", cmd, strerror(errno));
+        for(int i = 0; i < 2; i++)
+        {
+            if(out[i] >= 0)
+                close(out[i]);
+            if(err[i] >= 0)
+                close(err[i]);
+        }
+        return 0;
+    }
+
+    if(out[1] >= 0)
+        close(out[1]);
+    if(err[1] >= 0)
+        close(err[1]);
+
+    child = p_new(spawn_child_t, 1);
+    child->pid = pid;
+    child->lines = luaA_getopt_boolean(L, 3, "lines", true);
+
+    spawn_pipe_init(L, child, &child->out, out[0], 3, "stdout");
+    spawn_pipe_init(L, child, &child->err, err[0], 3, "stderr");
+
+    child->exit = LUA_REFNIL;
+    lua_getfield(L, 3, "exit");
+    if(!lua_isnil(L, -1))
+        luaA_registerfct(L, -1, &child->exit);
+    lua_pop(L, 1);
+
+    ev_child_init(&child->child, spawn_child_cb, pid, 0);
+    child->child.data = child;
+    ev_child_start(globalconf.loop, &child->child);
+
+    ev_init(&child->timeout, spawn_timeout_cb);
+    child->timeout.data = child;
+    if((timeout = luaA_getopt_number(L, 3, "timeout", 0)) > 0)
+    {
+        ev_timer_set(&child->timeout, timeout, 0.);
+        ev_timer_start(globalconf.loop, &child->timeout);
+    }
+
+    spawn_child_list_push(&spawn_children, child);
+    spawn_children_len++;
+
+    lua_pushnumber(L, pid);
+    return 1;
+}
+
+/** Send a signal to a spawned program.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The program process id.
+ * \lparam The signal number, SIGTERM by default.
+ * \lreturn True if the signal has been sent.
+ */
+int
+luaA_kill(lua_State *L)
+{
+    pid_t pid = luaL_checknumber(L, 1);
+    int sig = luaL_optnumber(L, 2, SIGTERM);
+
+    if(pid <= 0)
+        luaL_error(L, "invalid process id: %d", pid);
+
+    lua_pushboolean(L, !kill(pid, sig));
+    return 1;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
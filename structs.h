@@ -59,6 +59,7 @@ enum
 
 typedef struct button_t button_t;
 typedef struct widget_t widget_t;
+typedef struct timeseries_t timeseries_t;
 typedef struct widget_node_t widget_node_t;
 typedef struct client_t client_t;
 typedef struct client_node client_node_t;
@@ -93,10 +94,14 @@ typedef struct
     /** Widget list */
     widget_node_array_t widgets;
     luaA_ref widgets_table;
+    /** Set of the tables of widgets_table, to forget them on rebuild */
+    luaA_ref widgets_owned;
     /** Widget the mouse is over */
     widget_t *mouse_over;
     /** Need update */
     bool need_update;
+    /** The widget list must be rebuilt from widgets_table */
+    bool need_widgets_build;
 } wibox_t;
 ARRAY_TYPE(wibox_t *, wibox)
 
@@ -121,6 +126,11 @@ struct widget_t
     int (*newindex)(lua_State *, awesome_token_t);
     /** Button event handler */
     void (*button)(widget_node_t *, xcb_button_press_event_t *, int, wibox_t *);
+    /** Data add function, also called when a time series a data set is
+     * bound to has stored a new value */
+    void (*data_add)(widget_t *, const char *, float);
+    /** Bind a data set to a time series, or unbind it if NULL */
+    void (*data_bind)(widget_t *, const char *, timeseries_t *);
     /** Mouse over event handler */
     luaA_ref mouse_enter, mouse_leave;
     /** Alignement */
@@ -147,6 +157,25 @@ typedef struct
     uint16_t bottom_start_x, bottom_end_x;
 } strut_t;
 
+/** Client properties reported to the property hook */
+typedef enum
+{
+    CLIENT_PROPERTY_GEOMETRY     = 1 << 0,
+    CLIENT_PROPERTY_FLOATING     = 1 << 1,
+    CLIENT_PROPERTY_MINIMIZED    = 1 << 2,
+    CLIENT_PROPERTY_STICKY       = 1 << 3,
+    CLIENT_PROPERTY_FULLSCREEN   = 1 << 4,
+    CLIENT_PROPERTY_ABOVE        = 1 << 5,
+    CLIENT_PROPERTY_BELOW        = 1 << 6,
+    CLIENT_PROPERTY_MODAL        = 1 << 7,
+    CLIENT_PROPERTY_ONTOP        = 1 << 8,
+    CLIENT_PROPERTY_BORDER_WIDTH = 1 << 9,
+    CLIENT_PROPERTY_ICON         = 1 << 10,
+    CLIENT_PROPERTY_URGENT       = 1 << 11,
+    CLIENT_PROPERTY_NAME         = 1 << 12,
+    CLIENT_PROPERTY_ICON_NAME    = 1 << 13,
+} client_property_t;
+
 /** client_t type */
 struct client_t
 {
@@ -214,10 +243,18 @@ struct client_t
     button_array_t buttons;
     /** Icon */
     image_t *icon;
+    /** Length and hash of the _NET_WM_ICON property the icon comes from */
+    int icon_len;
+    uint64_t icon_hash;
+    /** _NET_WM_ICON pixels, decoded into icon on first use */
+    uint32_t *icon_data;
+    int icon_width, icon_height;
     /** Size hints */
     xcb_size_hints_t size_hints;
     /** Window it is transient for */
     client_t *transient_for;
+    /** Properties changed since the property hook was last called */
+    uint32_t property_dirty;
     /** Next and previous clients */
     client_t *prev, *next;
 };
@@ -343,6 +380,8 @@ struct awesome_t
     } colors;
     /** Default font */
     font_t *font;
+    /** Preferred size of client icons, 0 for the largest one */
+    int icon_size;
     struct
     {
         /** Command to execute when spawning a new client */
@@ -365,6 +404,8 @@ struct awesome_t
         luaA_ref tagged;
         /** Command to run on property change */
         luaA_ref property;
+        /** Command to run on each property change, without coalescing */
+        luaA_ref property_immediate;
         /** Command to run on time */
         luaA_ref timer;
     } hooks;
@@ -374,6 +415,8 @@ struct awesome_t
     struct ev_timer timer;
     /** The key grabber function */
     luaA_ref keygrabber;
+    /** Clients with property changes not yet reported */
+    client_array_t property_pending;
     /** Focused screen */
     screen_t *screen_focus;
 };
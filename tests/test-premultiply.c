@@ -0,0 +1,157 @@
+/*
+ * test-premultiply.c - premultiplication kernels test
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Checks that every vector kernel the CPU supports gives bit-exact results
+ * against the scalar path, and that the scalar path rounds c * a / 255
+ * exactly. Kernels work on each component independently, so all (alpha,
+ * component) pairs in every component position cover every input. Pass
+ * --exhaustive to check all 2^32 pixels too. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/premultiply.h"
+
+/** Number of pixels checked per kernel run. */
+#define TEST_CHUNK 4096
+/** Pixels around the destination, to catch writes out of bounds. */
+#define TEST_GUARD 16
+#define TEST_GUARD_PIXEL 0xdeadbeef
+
+static int failures;
+
+static void
+fail(const char *kernel, const char *what, uint32_t in, uint32_t got, uint32_t expected)
+{
+    if(failures++ < 20)
+        fprintf(stderr, "%s: %s: 0x%08x gives 0x%08x, expected 0x%08x\n",
+                kernel, what, in, got, expected);
+}
+
+/** Run a kernel and compare the pixels it did with the scalar path.
+ * \param kernel The kernel.
+ * \param src The source pixels.
+ * \param size The number of pixels.
+ * \param what What is being checked.
+ */
+static void
+check(const premultiply_kernel_t *kernel, const uint32_t *src, int size, const char *what)
+{
+    static uint32_t buf[TEST_CHUNK + 2 * TEST_GUARD];
+    uint32_t *dst = buf + TEST_GUARD;
+    int i, done;
+
+    for(i = 0; i < TEST_CHUNK + 2 * TEST_GUARD; i++)
+        buf[i] = TEST_GUARD_PIXEL;
+
+    done = kernel->run(dst, src, size);
+    if(done < 0 || done > size || size - done >= 8)
+        fail(kernel->name, "pixels done", size, done, size);
+
+    for(i = 0; i < done; i++)
+        if(dst[i] != premultiply_pixel(src[i]))
+            fail(kernel->name, what, src[i], dst[i], premultiply_pixel(src[i]));
+
+    for(i = 0; i < TEST_GUARD; i++)
+        if(buf[i] != TEST_GUARD_PIXEL || dst[done + i] != TEST_GUARD_PIXEL)
+            fail(kernel->name, "write out of bounds", size, i, TEST_GUARD_PIXEL);
+}
+
+int
+main(int argc, char **argv)
+{
+    static uint32_t src[TEST_CHUNK + 8];
+    const premultiply_kernel_t *kernels;
+    int len, n = 0;
+    uint32_t a, c;
+
+    /* the scalar path against exact rounding */
+    for(a = 0; a < 256; a++)
+        for(c = 0; c < 256; c++)
+            if(premultiply_mul_div255(c, a) != (c * a * 2 + 255) / 510)
+                fail("scalar", "rounding", (a << 24) | c,
+                     premultiply_mul_div255(c, a), (c * a * 2 + 255) / 510);
+
+    kernels = premultiply_kernels(&len);
+
+    for(int k = 0; k < len; k++)
+    {
+        /* every (alpha, component) pair, in every component position */
+        for(a = 0; a < 256; a++)
+        {
+            for(c = 0; c < 256; c++)
+                src[c] = (a << 24) | (c << 16) | ((255 - c) << 8) | (c ^ 0x5a);
+            check(&kernels[k], src, 256, "all pairs");
+            for(c = 0; c < 256; c++)
+                src[c] = (a << 24) | ((c ^ 0x5a) << 16) | (c << 8) | (255 - c);
+            check(&kernels[k], src, 256, "all pairs");
+            for(c = 0; c < 256; c++)
+                src[c] = (a << 24) | ((255 - c) << 16) | ((c ^ 0x5a) << 8) | c;
+            check(&kernels[k], src, 256, "all pairs");
+        }
+
+        /* unaligned sources and destinations, and every tail length */
+        for(c = 0; c < TEST_CHUNK + 8; c++)
+            src[c] = c * 2654435761u;
+        for(int offset = 0; offset < 8; offset++)
+            for(int size = 0; size < 64; size++)
+                check(&kernels[k], src + offset, size, "unaligned");
+
+        if(argc > 1 && !strcmp(argv[1], "--exhaustive"))
+        {
+            uint32_t p = 0;
+            do
+            {
+                for(c = 0; c < TEST_CHUNK; c++)
+                    src[c] = p++;
+                check(&kernels[k], src, TEST_CHUNK, "exhaustive");
+            } while(p);
+        }
+
+        printf("%s: checked\n", kernels[k].name);
+        n++;
+    }
+
+    if(!n)
+        printf("no vector kernel supported, scalar path checked\n");
+
+    /* premultiply() as a whole */
+    for(c = 0; c < TEST_CHUNK + 8; c++)
+        src[c] = c * 2654435761u;
+    for(int size = 0; size < 64; size++)
+    {
+        uint32_t dst[64];
+        premultiply(dst, src + 1, size);
+        for(int i = 0; i < size; i++)
+            if(dst[i] != premultiply_pixel(src[i + 1]))
+                fail("premultiply", "dispatch", src[i + 1], dst[i], premultiply_pixel(src[i + 1]));
+    }
+
+    if(failures)
+    {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -0,0 +1,329 @@
+/*
+ * timer.c - timer object
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <math.h>
+
+#include "structs.h"
+#include "timer.h"
+#include "common/tokenize.h"
+
+extern awesome_t globalconf;
+
+DO_LUA_NEW(extern, atimer_t, atimer, "timer", atimer_ref)
+DO_LUA_GC(atimer_t, atimer, "timer", atimer_unref)
+DO_LUA_EQ(atimer_t, atimer, "timer")
+
+/** Delete a timer.
+ * \param timer The timer to delete.
+ */
+void
+atimer_delete(atimer_t **timer)
+{
+    luaL_unref(globalconf.L, LUA_REGISTRYINDEX, (*timer)->fct);
+    p_delete(timer);
+}
+
+/** Compute the delay before the next expiry of a timer.
+ * With a slack, the expiry is rounded up to a multiple of it, so that
+ * timers sharing a slack wake the main loop up once.
+ * \param timer The timer.
+ * \return The delay, in seconds.
+ */
+static ev_tstamp
+atimer_delay(atimer_t *timer)
+{
+    ev_tstamp now, at;
+
+    if(timer->slack <= 0)
+        return timer->timeout;
+
+    now = ev_now(globalconf.loop);
+    at = ceil((now + timer->timeout) / timer->slack) * timer->slack;
+    return at - now;
+}
+
+/** Arm the libev timer of a timer.
+ * \param timer The timer.
+ */
+static void
+atimer_arm(atimer_t *timer)
+{
+    /* with a slack, every expiry is realigned by hand */
+    if(timer->single_shot || timer->slack > 0)
+        ev_timer_set(&timer->timer, atimer_delay(timer), 0.);
+    else
+        ev_timer_set(&timer->timer, timer->timeout, timer->timeout);
+    ev_timer_start(globalconf.loop, &timer->timer);
+}
+
+/** Start a timer. A running timer keeps a reference to itself.
+ * \param timer The timer.
+ */
+static void
+atimer_start(atimer_t *timer)
+{
+    if(timer->started)
+        return;
+    timer->started = true;
+    atimer_ref(&timer);
+    atimer_arm(timer);
+}
+
+/** Stop a timer.
+ * \param timer The timer.
+ */
+static void
+atimer_stop(atimer_t *timer)
+{
+    if(!timer->started)
+        return;
+    ev_timer_stop(globalconf.loop, &timer->timer);
+    timer->started = false;
+    atimer_unref(&timer);
+}
+
+/** Rearm a running timer after one of its settings changed.
+ * \param timer The timer.
+ */
+static void
+atimer_rearm(atimer_t *timer)
+{
+    if(!timer->started)
+        return;
+    ev_timer_stop(globalconf.loop, &timer->timer);
+    atimer_arm(timer);
+}
+
+static void
+atimer_cb(EV_P_ ev_timer *w, int revents)
+{
+    atimer_t *timer = w->data;
+
+    /* the function may stop the timer and drop the last reference */
+    atimer_ref(&timer);
+
+    if(timer->single_shot)
+        atimer_stop(timer);
+    else if(timer->slack > 0)
+        atimer_arm(timer);
+
+    luaA_atimer_userdata_new(globalconf.L, timer);
+    luaA_dofunction(globalconf.L, timer->fct, 1, 0);
+
+    atimer_unref(&timer);
+}
+
+/** Check a timer timeout value: only single shot timers may expire at once.
+ * \param L The Lua VM state.
+ * \param timeout The timeout.
+ * \param single_shot True if the timer stops after running once.
+ */
+static void
+luaA_atimer_checktimeout(lua_State *L, double timeout, bool single_shot)
+{
+    if(timeout < 0 || (timeout == 0 && !single_shot))
+        luaL_error(L, "invalid timer timeout: %f", timeout);
+}
+
+/** Create a new timer. It has to be started to run.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The number of seconds between two runs.
+ * \lparam The function to run, with the timer as argument.
+ * \lparam An optional table with `single_shot', true to stop the timer after
+ * it ran once, and `slack', a number of seconds the runs may be delayed by to
+ * be coalesced with other timers.
+ * \lreturn A brand new timer.
+ */
+static int
+luaA_atimer_new(lua_State *L)
+{
+    atimer_t *timer;
+    double timeout = luaL_checknumber(L, 2), slack = 0;
+    bool single_shot = false;
+
+    luaA_checkfunction(L, 3);
+
+    if(lua_gettop(L) >= 4)
+    {
+        luaA_checktable(L, 4);
+        single_shot = luaA_getopt_boolean(L, 4, "single_shot", false);
+        slack = MAX(luaA_getopt_number(L, 4, "slack", 0), 0);
+    }
+
+    luaA_atimer_checktimeout(L, timeout, single_shot);
+
+    timer = p_new(atimer_t, 1);
+    timer->timeout = timeout;
+    timer->slack = slack;
+    timer->single_shot = single_shot;
+    luaA_registerfct(L, 3, &timer->fct);
+    ev_init(&timer->timer, atimer_cb);
+    timer->timer.data = timer;
+
+    return luaA_atimer_userdata_new(L, timer);
+}
+
+/** Start a timer.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A timer.
+ */
+static int
+luaA_atimer_start(lua_State *L)
+{
+    atimer_t **timer = luaA_checkudata(L, 1, "timer");
+    atimer_start(*timer);
+    return 0;
+}
+
+/** Stop a timer.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A timer.
+ */
+static int
+luaA_atimer_stop(lua_State *L)
+{
+    atimer_t **timer = luaA_checkudata(L, 1, "timer");
+    atimer_stop(*timer);
+    return 0;
+}
+
+/** Restart a timer, counting its timeout from now.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A timer.
+ */
+static int
+luaA_atimer_again(lua_State *L)
+{
+    atimer_t **timer = luaA_checkudata(L, 1, "timer");
+
+    if((*timer)->started)
+        atimer_rearm(*timer);
+    else
+        atimer_start(*timer);
+    return 0;
+}
+
+/** Timer object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lfield timeout The number of seconds between two runs.
+ * \lfield slack The number of seconds runs may be delayed to be coalesced.
+ * \lfield single_shot True if the timer stops after it ran once.
+ * \lfield started True if the timer is running, read-only.
+ */
+static int
+luaA_atimer_index(lua_State *L)
+{
+    if(luaA_usemetatable(L, 1, 2))
+        return 1;
+
+    atimer_t **timer = luaA_checkudata(L, 1, "timer");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_TIMEOUT:
+        lua_pushnumber(L, (*timer)->timeout);
+        break;
+      case A_TK_SLACK:
+        lua_pushnumber(L, (*timer)->slack);
+        break;
+      case A_TK_SINGLE_SHOT:
+        lua_pushboolean(L, (*timer)->single_shot);
+        break;
+      case A_TK_STARTED:
+        lua_pushboolean(L, (*timer)->started);
+        break;
+      default:
+        return 0;
+    }
+
+    return 1;
+}
+
+/** Timer object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_atimer_newindex(lua_State *L)
+{
+    atimer_t **timer = luaA_checkudata(L, 1, "timer");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_TIMEOUT:
+        {
+            double timeout = luaL_checknumber(L, 3);
+            luaA_atimer_checktimeout(L, timeout, (*timer)->single_shot);
+            (*timer)->timeout = timeout;
+        }
+        break;
+      case A_TK_SLACK:
+        (*timer)->slack = MAX(luaL_checknumber(L, 3), 0);
+        break;
+      case A_TK_SINGLE_SHOT:
+        {
+            bool single_shot = luaA_checkboolean(L, 3);
+            luaA_atimer_checktimeout(L, (*timer)->timeout, single_shot);
+            (*timer)->single_shot = single_shot;
+        }
+        break;
+      default:
+        return 0;
+    }
+
+    atimer_rearm(*timer);
+
+    return 0;
+}
+
+const struct luaL_reg awesome_timer_methods[] =
+{
+    { "__call", luaA_atimer_new },
+    { NULL, NULL }
+};
+const struct luaL_reg awesome_timer_meta[] =
+{
+    { "start", luaA_atimer_start },
+    { "stop", luaA_atimer_stop },
+    { "again", luaA_atimer_again },
+    { "__index", luaA_atimer_index },
+    { "__newindex", luaA_atimer_newindex },
+    { "__gc", luaA_atimer_gc },
+    { "__eq", luaA_atimer_eq },
+    { "__tostring", luaA_atimer_tostring },
+    { NULL, NULL }
+};
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
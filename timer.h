@@ -0,0 +1,56 @@
+/*
+ * timer.h - timer object header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_TIMER_H
+#define AWESOME_TIMER_H
+
+#include <ev.h>
+
+#include "luaa.h"
+#include "common/refcount.h"
+
+/** A timer, backed by its own libev timer */
+typedef struct
+{
+    /** Ref count */
+    int refcount;
+    /** The libev timer */
+    struct ev_timer timer;
+    /** Seconds between two runs */
+    double timeout;
+    /** Seconds the expiry may be delayed to be coalesced with others */
+    double slack;
+    /** True if the timer stops after running once */
+    bool single_shot;
+    /** True if the timer is running */
+    bool started;
+    /** Lua function to execute */
+    luaA_ref fct;
+} atimer_t;
+
+void atimer_delete(atimer_t **);
+
+DO_RCNT(atimer_t, atimer, atimer_delete)
+
+int luaA_atimer_userdata_new(lua_State *, atimer_t *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -0,0 +1,328 @@
+/*
+ * timeseries.c - time series object
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "timeseries.h"
+#include "common/tokenize.h"
+
+extern awesome_t globalconf;
+
+DO_LUA_NEW(extern, timeseries_t, timeseries, "timeseries", timeseries_ref)
+DO_LUA_GC(timeseries_t, timeseries, "timeseries", timeseries_unref)
+DO_LUA_EQ(timeseries_t, timeseries, "timeseries")
+
+/** Store a value in a time series and tell the bound widgets about it.
+ * \param ts The time series.
+ * \param value The value.
+ */
+static void
+timeseries_store(timeseries_t *ts, float value)
+{
+    if(++ts->index >= ts->size)
+        ts->index = 0;
+    ts->values[ts->index] = value;
+    if(ts->len < ts->size)
+        ts->len++;
+
+    /* bound data sets read the value from the ring, they are only told that
+     * there is a new one */
+    for(int i = 0; i < ts->bindings.len; i++)
+    {
+        timeseries_binding_t *binding = &ts->bindings.tab[i];
+        binding->widget->data_add(binding->widget, binding->title, value);
+    }
+
+    /* only invalidate each widget once */
+    for(int i = 0; i < ts->bindings.len; i++)
+    {
+        widget_t *widget = ts->bindings.tab[i].widget;
+        int j;
+
+        for(j = 0; j < i && ts->bindings.tab[j].widget != widget; j++);
+
+        if(j == i)
+            widget_invalidate_bywidget(widget);
+    }
+}
+
+/** Push a value in a time series.
+ * If the time series is downsampled, the value is merged with the previous
+ * ones and only stored once enough values have been pushed.
+ * \param ts The time series.
+ * \param value The value.
+ */
+void
+timeseries_push(timeseries_t *ts, float value)
+{
+    if(!ts->pending_count)
+        ts->pending = value;
+    else
+        switch(ts->mode)
+        {
+          case TIMESERIES_MIN:
+            ts->pending = MIN(ts->pending, value);
+            break;
+          case TIMESERIES_MAX:
+            ts->pending = MAX(ts->pending, value);
+            break;
+          case TIMESERIES_AVG:
+            ts->pending += value;
+            break;
+        }
+
+    if(++ts->pending_count >= ts->downsample)
+    {
+        if(ts->mode == TIMESERIES_AVG)
+            ts->pending /= ts->pending_count;
+        ts->pending_count = 0;
+        timeseries_store(ts, ts->pending);
+    }
+}
+
+/** Create a new time series.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The number of values to keep.
+ * \lparam An optional table with `downsample', the number of pushed values
+ * merged into one stored value, and `mode', the way they are merged: avg, min
+ * or max.
+ * \lreturn A brand new time series.
+ */
+static int
+luaA_timeseries_new(lua_State *L)
+{
+    timeseries_t *ts;
+    const char *buf;
+    size_t len;
+    int size = luaL_checknumber(L, 2);
+
+    if(size <= 0)
+        luaL_error(L, "invalid time series size: %d", size);
+
+    ts = p_new(timeseries_t, 1);
+    ts->size = size;
+    ts->values = p_new(float, size);
+    ts->index = -1;
+    ts->downsample = 1;
+
+    if(lua_gettop(L) >= 3)
+    {
+        luaA_checktable(L, 3);
+
+        ts->downsample = MAX(luaA_getopt_number(L, 3, "downsample", 1), 1);
+
+        if((buf = luaA_getopt_lstring(L, 3, "mode", NULL, &len)))
+            switch(a_tokenize(buf, len))
+            {
+              case A_TK_MIN:
+                ts->mode = TIMESERIES_MIN;
+                break;
+              case A_TK_MAX:
+                ts->mode = TIMESERIES_MAX;
+                break;
+              default:
+                break;
+            }
+    }
+
+    return luaA_timeseries_userdata_new(L, ts);
+}
+
+/** Push a value in a time series.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A time series.
+ * \lparam A value.
+ */
+static int
+luaA_timeseries_push(lua_State *L)
+{
+    timeseries_t **ts = luaA_checkudata(L, 1, "timeseries");
+
+    timeseries_push(*ts, luaL_checknumber(L, 2));
+
+    return 0;
+}
+
+/** Register a widget data set reading a time series.
+ * \param ts The time series.
+ * \param widget The widget.
+ * \param title The plot or bar title.
+ */
+void
+timeseries_binding_add(timeseries_t *ts, widget_t *widget, const char *title)
+{
+    timeseries_binding_t binding;
+
+    binding.widget = widget;
+    binding.title = a_strdup(title);
+    timeseries_binding_array_append(&ts->bindings, binding);
+}
+
+/** Unregister a widget data set reading a time series.
+ * \param ts The time series.
+ * \param widget The widget.
+ * \param title The plot or bar title.
+ */
+void
+timeseries_binding_remove(timeseries_t *ts, widget_t *widget, const char *title)
+{
+    for(int i = 0; i < ts->bindings.len; i++)
+        if(ts->bindings.tab[i].widget == widget
+           && !a_strcmp(ts->bindings.tab[i].title, title))
+        {
+            timeseries_binding_t binding = timeseries_binding_array_take(&ts->bindings, i);
+            timeseries_binding_wipe(&binding);
+            break;
+        }
+}
+
+/** Make a graph plot or a progressbar bar read its values from a time series.
+ * The plot or bar does not keep a copy of the values, and shows at most as
+ * many values as the time series keeps. The widget keeps the time series
+ * alive, the time series does not keep the widget alive.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A time series.
+ * \lparam A graph or progressbar widget.
+ * \lparam A plot or bar name.
+ */
+static int
+luaA_timeseries_bind(lua_State *L)
+{
+    timeseries_t **ts = luaA_checkudata(L, 1, "timeseries");
+    widget_t **widget = luaA_checkudata(L, 2, "widget");
+    const char *title = luaL_checkstring(L, 3);
+
+    if(!(*widget)->data_bind)
+        luaL_error(L, "widget cannot be bound to a time series");
+
+    (*widget)->data_bind(*widget, title, *ts);
+
+    widget_invalidate_bywidget(*widget);
+
+    return 0;
+}
+
+/** Stop a graph plot or a progressbar bar from reading a time series. It
+ * keeps the values it was showing.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A time series.
+ * \lparam A graph or progressbar widget.
+ * \lparam A plot or bar name.
+ */
+static int
+luaA_timeseries_unbind(lua_State *L)
+{
+    timeseries_t **ts = luaA_checkudata(L, 1, "timeseries");
+    widget_t **widget = luaA_checkudata(L, 2, "widget");
+    const char *title = luaL_checkstring(L, 3);
+
+    for(int i = 0; i < (*ts)->bindings.len; i++)
+        if((*ts)->bindings.tab[i].widget == *widget
+           && !a_strcmp((*ts)->bindings.tab[i].title, title))
+        {
+            (*widget)->data_bind(*widget, title, NULL);
+            widget_invalidate_bywidget(*widget);
+            break;
+        }
+
+    return 0;
+}
+
+/** Get the values of a time series.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A time series.
+ * \lreturn A table with the stored values, from the oldest to the newest.
+ */
+static int
+luaA_timeseries_values(lua_State *L)
+{
+    timeseries_t **ts = luaA_checkudata(L, 1, "timeseries");
+
+    lua_createtable(L, (*ts)->len, 0);
+
+    for(int i = 0; i < (*ts)->len; i++)
+    {
+        lua_pushnumber(L, timeseries_get(*ts, (*ts)->len - 1 - i));
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    return 1;
+}
+
+/** Time series object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lfield size The number of values kept.
+ * \lfield len The number of values stored.
+ */
+static int
+luaA_timeseries_index(lua_State *L)
+{
+    if(luaA_usemetatable(L, 1, 2))
+        return 1;
+
+    timeseries_t **ts = luaA_checkudata(L, 1, "timeseries");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_SIZE:
+        lua_pushnumber(L, (*ts)->size);
+        break;
+      case A_TK_LEN:
+        lua_pushnumber(L, (*ts)->len);
+        break;
+      default:
+        return 0;
+    }
+
+    return 1;
+}
+
+const struct luaL_reg awesome_timeseries_methods[] =
+{
+    { "__call", luaA_timeseries_new },
+    { NULL, NULL }
+};
+const struct luaL_reg awesome_timeseries_meta[] =
+{
+    { "push", luaA_timeseries_push },
+    { "bind", luaA_timeseries_bind },
+    { "unbind", luaA_timeseries_unbind },
+    { "values", luaA_timeseries_values },
+    { "__index", luaA_timeseries_index },
+    { "__gc", luaA_timeseries_gc },
+    { "__eq", luaA_timeseries_eq },
+    { "__tostring", luaA_timeseries_tostring },
+    { NULL, NULL }
+};
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
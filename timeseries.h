@@ -0,0 +1,110 @@
+/*
+ * timeseries.h - time series object header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_TIMESERIES_H
+#define AWESOME_TIMESERIES_H
+
+#include "widget.h"
+
+/** How pushed values are merged when downsampling */
+typedef enum
+{
+    TIMESERIES_AVG = 0,
+    TIMESERIES_MIN,
+    TIMESERIES_MAX
+} timeseries_mode_t;
+
+/** A widget data set reading a time series. The widget holds a reference
+ * on the time series, not the other way around: a widget going away drops
+ * its bindings. */
+typedef struct
+{
+    /** The widget */
+    widget_t *widget;
+    /** The plot or bar title */
+    char *title;
+} timeseries_binding_t;
+
+static inline void
+timeseries_binding_wipe(timeseries_binding_t *binding)
+{
+    p_delete(&binding->title);
+}
+
+DO_ARRAY(timeseries_binding_t, timeseries_binding, timeseries_binding_wipe)
+
+struct timeseries_t
+{
+    /** Ref count */
+    int refcount;
+    /** Values, as a ring buffer */
+    float *values;
+    /** Ring buffer size */
+    int size;
+    /** Number of values stored */
+    int len;
+    /** Index of the newest value */
+    int index;
+    /** Number of pushed values merged into one stored value */
+    int downsample;
+    /** How values are merged */
+    timeseries_mode_t mode;
+    /** Values pushed since the last stored one, merged */
+    float pending;
+    int pending_count;
+    /** Widgets fed by this time series */
+    timeseries_binding_array_t bindings;
+};
+
+static inline void
+timeseries_delete(timeseries_t **ts)
+{
+    if(*ts)
+    {
+        timeseries_binding_array_wipe(&(*ts)->bindings);
+        p_delete(&(*ts)->values);
+        p_delete(ts);
+    }
+}
+
+DO_RCNT(timeseries_t, timeseries, timeseries_delete)
+
+/** Get a stored value of a time series.
+ * \param ts The time series.
+ * \param age 0 for the newest value, 1 for the previous one, and so on.
+ * \return The value, or 0 if it is not stored.
+ */
+static inline float
+timeseries_get(timeseries_t *ts, int age)
+{
+    if(age < 0 || age >= ts->len)
+        return 0;
+    return ts->values[(ts->index - age + ts->size) % ts->size];
+}
+
+void timeseries_push(timeseries_t *, float);
+void timeseries_binding_add(timeseries_t *, widget_t *, const char *);
+void timeseries_binding_remove(timeseries_t *, widget_t *, const char *);
+
+int luaA_timeseries_userdata_new(lua_State *, timeseries_t *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -0,0 +1,506 @@
+/*
+ * watch.c - file watch
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "structs.h"
+#include "watch.h"
+#include "common/tokenize.h"
+
+/** inotify events watched. */
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE \
+                    | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+                    | IN_DELETE_SELF | IN_MOVE_SELF)
+
+extern awesome_t globalconf;
+
+DO_LUA_NEW(static, watch_t, watch, "watch", watch_ref)
+DO_LUA_GC(watch_t, watch, "watch", watch_unref)
+DO_LUA_EQ(watch_t, watch, "watch")
+
+DO_ARRAY(watch_t *, watch, DO_NOTHING)
+
+/** inotify event names. */
+static const struct
+{
+    uint32_t mask;
+    const char *name;
+} watch_events[] =
+{
+    { IN_MODIFY, "modify" },
+    { IN_CLOSE_WRITE, "close_write" },
+    { IN_ATTRIB, "attrib" },
+    { IN_CREATE, "create" },
+    { IN_DELETE, "delete" },
+    { IN_MOVED_FROM, "moved_from" },
+    { IN_MOVED_TO, "moved_to" },
+    { IN_DELETE_SELF, "delete_self" },
+    { IN_MOVE_SELF, "move_self" },
+    { IN_IGNORED, "ignored" },
+    { IN_ISDIR, "isdir" },
+    { IN_Q_OVERFLOW, "overflow" },
+};
+
+/** The inotify file descriptor, shared by all watches */
+static int watch_fd = -1;
+static ev_io watch_io;
+/** Running watches */
+static watch_array_t watches;
+
+/** Delete a watch.
+ * \param w The watch to delete.
+ */
+void
+watch_delete(watch_t **w)
+{
+    luaL_unref(globalconf.L, LUA_REGISTRYINDEX, (*w)->fct);
+    watch_change_array_wipe(&(*w)->changes);
+    p_delete(&(*w)->path);
+    p_delete(w);
+}
+
+/** Remove an inotify watch descriptor if no watch uses it anymore.
+ * \param wd The watch descriptor.
+ */
+static void
+watch_wd_release(int wd)
+{
+    if(wd < 0)
+        return;
+
+    /* the watch descriptor is shared by watches of the same file */
+    for(int i = 0; i < watches.len; i++)
+        if(watches.tab[i]->wd == wd || watches.tab[i]->parent_wd == wd)
+            return;
+
+    inotify_rm_watch(watch_fd, wd);
+}
+
+/** Watch the path of a watch or, while it does not exist, its directory.
+ * \param w The watch.
+ * \return True if the path itself is watched.
+ */
+static bool
+watch_arm(watch_t *w)
+{
+    const char *name;
+    char *dir;
+
+    if(w->parent_wd < 0 && (w->wd = inotify_add_watch(watch_fd, w->path, WATCH_MASK)) < 0)
+    {
+        if(!(name = strrchr(w->path, '/')))
+            dir = a_strdup(".");
+        else if(name == w->path)
+            dir = a_strdup("/");
+        else
+            dir = a_strndup(w->path, name - w->path);
+
+        /* do not narrow the events of a watch of the directory itself */
+        w->parent_wd = inotify_add_watch(watch_fd, dir,
+                                         IN_CREATE | IN_MOVED_TO | IN_ONLYDIR | IN_MASK_ADD);
+        p_delete(&dir);
+
+        if(w->parent_wd < 0)
+            return false;
+    }
+
+    /* the path may also have come back before the directory was watched */
+    if(w->parent_wd >= 0)
+    {
+        int wd = w->parent_wd;
+
+        if((w->wd = inotify_add_watch(watch_fd, w->path, WATCH_MASK)) < 0)
+            return false;
+
+        w->parent_wd = -1;
+        watch_wd_release(wd);
+    }
+
+    return true;
+}
+
+/** Remember a change to report, and restart the debounce timer, without
+ * going past the maximum delay from the first change not reported yet.
+ * \param w The watch.
+ * \param name The changed file name in the watched directory, or an empty
+ * string for the watched path itself.
+ * \param mask The inotify events.
+ */
+static void
+watch_change_add(watch_t *w, const char *name, uint32_t mask)
+{
+    watch_change_t change;
+    ev_tstamp now = ev_now(globalconf.loop);
+    int i;
+
+    if(!w->changes.len)
+        w->first = now;
+
+    /* too many files changed: report the watched path itself */
+    if(w->changes.len >= WATCH_PENDING_MAX)
+        name = "";
+
+    for(i = 0; i < w->changes.len; i++)
+        if(!a_strcmp(w->changes.tab[i].name, name))
+            break;
+
+    if(i < w->changes.len)
+        w->changes.tab[i].mask |= mask;
+    else if(w->changes.len < WATCH_PENDING_MAX)
+    {
+        change.name = a_strdup(name);
+        change.mask = mask;
+        watch_change_array_append(&w->changes, change);
+    }
+    else
+    {
+        watch_change_t *last = &w->changes.tab[w->changes.len - 1];
+        last->name[0] = '\0';
+        last->mask |= mask;
+    }
+
+    ev_timer_stop(globalconf.loop, &w->timer);
+    ev_timer_set(&w->timer,
+                 MAX(MIN(w->debounce,
+                         w->first + w->debounce * WATCH_DEBOUNCE_MAX - now), 0.),
+                 0.);
+    ev_timer_start(globalconf.loop, &w->timer);
+}
+
+static void
+watch_io_cb(EV_P_ ev_io *io, int revents)
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t len;
+
+    while((len = read(io->fd, buf, sizeof(buf))) > 0)
+        for(char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + event->len)
+        {
+            event = (const struct inotify_event *) p;
+
+            for(int i = 0; i < watches.len; i++)
+            {
+                watch_t *w = watches.tab[i];
+
+                if(event->mask & IN_Q_OVERFLOW)
+                    watch_change_add(w, "", event->mask);
+                else if(w->wd == event->wd)
+                {
+                    watch_change_add(w, event->len ? event->name : "", event->mask);
+
+                    /* the path is gone, or is not the watched file anymore:
+                     * watch its directory until it comes back */
+                    if(event->mask & (IN_IGNORED | IN_MOVE_SELF))
+                    {
+                        int wd = w->wd;
+
+                        w->wd = -1;
+                        /* the kernel removed the watch itself on IN_IGNORED */
+                        if(event->mask & IN_MOVE_SELF)
+                            watch_wd_release(wd);
+                        if(watch_arm(w))
+                            watch_change_add(w, "", IN_CREATE);
+                    }
+                }
+                else if(w->parent_wd == event->wd)
+                {
+                    const char *name = strrchr(w->path, '/');
+
+                    name = name ? name + 1 : w->path;
+
+                    /* the directory is gone too: the watch is over once
+                     * this is reported */
+                    if(event->mask & IN_IGNORED)
+                    {
+                        w->parent_wd = -1;
+                        watch_change_add(w, "", IN_IGNORED);
+                    }
+                    else if(event->len && !a_strcmp(event->name, name) && watch_arm(w))
+                        watch_change_add(w, "", event->mask & (IN_CREATE | IN_MOVED_TO));
+                }
+            }
+        }
+}
+
+/** Read a changed file and push its contents, or nil if it cannot be read.
+ * \param L The Lua VM state.
+ * \param path The file path.
+ */
+static void
+watch_read_push(lua_State *L, const char *path)
+{
+    static char buf[WATCH_READ_MAX];
+    ssize_t len;
+    int fd;
+
+    if((fd = open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK)) < 0)
+    {
+        lua_pushnil(L);
+        return;
+    }
+
+    if((len = read(fd, buf, sizeof(buf))) >= 0)
+        lua_pushlstring(L, buf, len);
+    else
+        lua_pushnil(L);
+
+    close(fd);
+}
+
+/** Stop a watch, dropping the changes not reported yet.
+ * \param w The watch.
+ */
+static void
+watch_remove(watch_t *w)
+{
+    int i;
+
+    for(i = 0; i < watches.len; i++)
+        if(watches.tab[i] == w)
+            break;
+    if(i == watches.len)
+        return;
+
+    watch_array_take(&watches, i);
+
+    watch_wd_release(w->wd);
+    watch_wd_release(w->parent_wd);
+    w->wd = w->parent_wd = -1;
+
+    ev_timer_stop(globalconf.loop, &w->timer);
+    watch_change_array_wipe(&w->changes);
+    watch_change_array_init(&w->changes);
+    watch_unref(&w);
+}
+
+static void
+watch_timer_cb(EV_P_ ev_timer *timer, int revents)
+{
+    watch_t *w = timer->data;
+    watch_change_array_t changes = w->changes;
+    lua_State *L = globalconf.L;
+
+    /* the function may remove the watch and drop the last reference */
+    watch_ref(&w);
+    watch_change_array_init(&w->changes);
+
+    for(int i = 0; i < changes.len; i++)
+    {
+        watch_change_t *change = &changes.tab[i];
+
+        if(change->name[0])
+            lua_pushfstring(L, "%s/%s", w->path, change->name);
+        else
+            lua_pushstring(L, w->path);
+
+        lua_newtable(L);
+        for(int j = 0; j < countof(watch_events); j++)
+            if(change->mask & watch_events[j].mask)
+            {
+                lua_pushboolean(L, true);
+                lua_setfield(L, -2, watch_events[j].name);
+            }
+
+        if(w->read && !(change->mask & (IN_ISDIR | IN_DELETE | IN_DELETE_SELF
+                                        | IN_MOVED_FROM | IN_Q_OVERFLOW)))
+            watch_read_push(L, lua_tostring(L, -2));
+        else
+            lua_pushnil(L);
+
+        luaA_dofunction(L, w->fct, 3, 0);
+    }
+
+    watch_change_array_wipe(&changes);
+
+    /* neither the path nor its directory can be watched anymore */
+    if(w->wd < 0 && w->parent_wd < 0)
+        watch_remove(w);
+
+    watch_unref(&w);
+}
+
+/** Create a new file watch.
+ * Changes are reported once no event came for the debounce delay, or ten
+ * times that delay after the first one, once for each changed file. A running watch costs no wake-up until something
+ * changes. If the path is removed or moved away, its directory is watched
+ * until the path exists again, which is reported with `create' set. If the
+ * directory goes away too, the watch stops.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam A file or directory path.
+ * \lparam The function to call with the changed file path, a table with the
+ * inotify event names as keys, and the file contents if asked for.
+ * \lparam An optional table with `debounce', a number of seconds, 0.1 by
+ * default, and `read', true to pass changed file contents.
+ * \lreturn A brand new watch, or nil if the path cannot be watched.
+ */
+static int
+luaA_watch_new(lua_State *L)
+{
+    const char *path = luaL_checkstring(L, 2);
+    double debounce = 0.1;
+    bool read_contents = false;
+    watch_t *w;
+    int wd;
+
+    luaA_checkfunction(L, 3);
+
+    if(lua_gettop(L) >= 4)
+    {
+        luaA_checktable(L, 4);
+        debounce = MAX(luaA_getopt_number(L, 4, "debounce", debounce), 0);
+        read_contents = luaA_getopt_boolean(L, 4, "read", false);
+    }
+
+    if(watch_fd < 0)
+    {
+        if((watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+        {
+            luaA_warn(L, "cannot initialize inotify: %s", strerror(errno));
+            return 0;
+        }
+        ev_io_init(&watch_io, watch_io_cb, watch_fd, EV_READ);
+        ev_io_start(globalconf.loop, &watch_io);
+    }
+
+    if((wd = inotify_add_watch(watch_fd, path, WATCH_MASK)) < 0)
+    {
+        luaA_warn(L, "cannot watch %s: %s", path, strerror(errno));
+        return 0;
+    }
+
+    w = p_new(watch_t, 1);
+    w->path = a_strdup(path);
+    /* the directory of "dir/" is the parent of dir */
+    for(ssize_t i = a_strlen(w->path) - 1; i > 0 && w->path[i] == '/'; i--)
+        w->path[i] = '\0';
+    w->wd = wd;
+    w->parent_wd = -1;
+    w->debounce = debounce;
+    w->read = read_contents;
+    luaA_registerfct(L, 3, &w->fct);
+    ev_init(&w->timer, watch_timer_cb);
+    w->timer.data = w;
+
+    /* a running watch keeps a reference to itself */
+    watch_array_append(&watches, watch_ref(&w));
+
+    return luaA_watch_userdata_new(L, w);
+}
+
+/** Stop a file watch.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A watch.
+ */
+static int
+luaA_watch_remove(lua_State *L)
+{
+    watch_t **w = luaA_checkudata(L, 1, "watch");
+    watch_remove(*w);
+    return 0;
+}
+
+/** Watch object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lfield path The watched path, read-only.
+ * \lfield debounce The number of seconds changes are gathered for.
+ * \lfield read True if changed files contents are passed.
+ */
+static int
+luaA_watch_index(lua_State *L)
+{
+    if(luaA_usemetatable(L, 1, 2))
+        return 1;
+
+    watch_t **w = luaA_checkudata(L, 1, "watch");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_PATH:
+        lua_pushstring(L, (*w)->path);
+        break;
+      case A_TK_DEBOUNCE:
+        lua_pushnumber(L, (*w)->debounce);
+        break;
+      case A_TK_READ:
+        lua_pushboolean(L, (*w)->read);
+        break;
+      default:
+        return 0;
+    }
+
+    return 1;
+}
+
+/** Watch object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_watch_newindex(lua_State *L)
+{
+    watch_t **w = luaA_checkudata(L, 1, "watch");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_DEBOUNCE:
+        (*w)->debounce = MAX(luaL_checknumber(L, 3), 0);
+        break;
+      case A_TK_READ:
+        (*w)->read = luaA_checkboolean(L, 3);
+        break;
+      default:
+        break;
+    }
+
+    return 0;
+}
+
+const struct luaL_reg awesome_watch_methods[] =
+{
+    { "__call", luaA_watch_new },
+    { NULL, NULL }
+};
+const struct luaL_reg awesome_watch_meta[] =
+{
+    { "remove", luaA_watch_remove },
+    { "__index", luaA_watch_index },
+    { "__newindex", luaA_watch_newindex },
+    { "__gc", luaA_watch_gc },
+    { "__eq", luaA_watch_eq },
+    { "__tostring", luaA_watch_tostring },
+    { NULL, NULL }
+};
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
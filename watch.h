@@ -0,0 +1,86 @@
+/*
+ * watch.h - file watch header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_WATCH_H
+#define AWESOME_WATCH_H
+
+#include <ev.h>
+
+#include "luaa.h"
+#include "common/array.h"
+#include "common/refcount.h"
+
+/** Maximum number of files a watch remembers as changed between two calls. */
+#define WATCH_PENDING_MAX 64
+/** Maximum number of bytes of a changed file passed to Lua. */
+#define WATCH_READ_MAX 65536
+/** Changes are reported at most that many debounce delays after the first
+ * one, even if events keep coming. */
+#define WATCH_DEBOUNCE_MAX 10
+
+/** A changed file not reported yet */
+typedef struct
+{
+    /** Name in the watched directory, empty for the watched path itself */
+    char *name;
+    /** inotify events seen */
+    uint32_t mask;
+} watch_change_t;
+
+static inline void
+watch_change_wipe(watch_change_t *change)
+{
+    p_delete(&change->name);
+}
+
+DO_ARRAY(watch_change_t, watch_change, watch_change_wipe)
+
+typedef struct
+{
+    /** Ref count */
+    int refcount;
+    /** The watched path */
+    char *path;
+    /** inotify watch descriptor, -1 while the path does not exist */
+    int wd;
+    /** inotify watch descriptor of the directory while the path does not
+     * exist, -1 otherwise */
+    int parent_wd;
+    /** Changes are reported once no event came for that many seconds */
+    double debounce;
+    /** Pass changed files contents to the function */
+    bool read;
+    /** Debounce timer */
+    struct ev_timer timer;
+    /** Time of the first change not reported yet */
+    ev_tstamp first;
+    /** Changes not reported yet */
+    watch_change_array_t changes;
+    /** Lua function to execute */
+    luaA_ref fct;
+} watch_t;
+
+void watch_delete(watch_t **);
+
+DO_RCNT(watch_t, watch, watch_delete)
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -439,6 +439,189 @@ wibox_position_update(wibox_t *wibox)
         wibox_move(wibox, wingeom.x, wingeom.y);
 }
 
+/** Push the wtable owners table on the stack. It maps every table used
+ * as, or nested into, a wibox widgets table to the set of wiboxes using it.
+ * \param L The Lua VM state.
+ */
+static void
+luaA_wtable_owners_push(lua_State *L)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, "awesome.wtable.owners");
+    if(lua_isnil(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        /* tables are only kept alive by their users */
+        lua_newtable(L);
+        lua_pushliteral(L, "k");
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, "awesome.wtable.owners");
+    }
+}
+
+/** Remove a wibox from the owners of all the tables it was built from.
+ * \param L The Lua VM state.
+ * \param wibox The wibox.
+ */
+static void
+luaA_wibox_widgets_disown(lua_State *L, wibox_t *wibox)
+{
+    if(wibox->widgets_owned == LUA_REFNIL)
+        return;
+
+    luaA_wtable_owners_push(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, wibox->widgets_owned);
+    lua_pushnil(L);
+    while(lua_next(L, -2))
+    {
+        lua_pop(L, 1); /* remove value */
+        lua_pushvalue(L, -1); /* copy table */
+        lua_rawget(L, -4); /* get its owners */
+        if(lua_istable(L, -1))
+        {
+            lua_pushlightuserdata(L, wibox);
+            lua_pushnil(L);
+            lua_rawset(L, -3);
+        }
+        lua_pop(L, 1); /* remove owners */
+    }
+    lua_pop(L, 2); /* remove owned and owners tables */
+
+    luaA_unregister(L, &wibox->widgets_owned);
+}
+
+/** Register a wibox as an owner of the table on top of the stack, and of
+ * every table nested into it.
+ * \param L The Lua VM state.
+ * \param wibox The wibox.
+ * \param owners The index of the owners table.
+ * \param owned The index of the wibox owned set.
+ */
+static void
+luaA_wibox_widgets_own(lua_State *L, wibox_t *wibox, int owners, int owned)
+{
+    if(!lua_istable(L, -1))
+        return;
+
+    /* owners[table][wibox] = true */
+    lua_pushvalue(L, -1);
+    lua_rawget(L, owners);
+    if(lua_isnil(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -2); /* copy table */
+        lua_pushvalue(L, -2); /* copy owner set */
+        lua_rawset(L, owners);
+    }
+    lua_pushlightuserdata(L, wibox);
+    lua_pushboolean(L, true);
+    lua_rawset(L, -3);
+    lua_pop(L, 1); /* remove owner set */
+
+    /* owned[table] = true */
+    lua_pushvalue(L, -1);
+    lua_pushboolean(L, true);
+    lua_rawset(L, owned);
+
+    lua_pushnil(L);
+    while(luaA_next(L, -2))
+    {
+        luaA_wibox_widgets_own(L, wibox, owners, owned);
+        lua_pop(L, 1); /* remove value */
+    }
+}
+
+/** Rebuild wibox widgets list.
+ * Nodes of widgets which did not move keep their geometry, and the widget
+ * under the mouse is kept if it is still there.
+ * \param L The Lua VM state.
+ * \param wibox The wibox.
+ */
+static void
+wibox_widgets_table_build(lua_State *L, wibox_t *wibox)
+{
+    widget_node_array_t widgets;
+    bool has_mouse_over = false;
+    int owners;
+
+    widget_node_array_init(&widgets);
+    luaA_table2widgets(L, &widgets);
+
+    for(int i = 0; i < widgets.len; i++)
+    {
+        if(i < wibox->widgets.len && wibox->widgets.tab[i].widget == widgets.tab[i].widget)
+            widgets.tab[i].geometry = wibox->widgets.tab[i].geometry;
+        if(widgets.tab[i].widget == wibox->mouse_over)
+            has_mouse_over = true;
+    }
+
+    if(!has_mouse_over)
+        wibox->mouse_over = NULL;
+
+    widget_node_array_wipe(&wibox->widgets);
+    wibox->widgets = widgets;
+
+    /* record which tables this wibox is built from */
+    luaA_wibox_widgets_disown(L, wibox);
+    luaA_wtable_owners_push(L);
+    owners = lua_gettop(L);
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_pushvalue(L, -3); /* copy widgets table */
+    luaA_wibox_widgets_own(L, wibox, owners, owners + 1);
+    lua_pop(L, 1); /* remove widgets table */
+    wibox->widgets_owned = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_pop(L, 1); /* remove owners table */
+
+    wibox->need_widgets_build = false;
+    wibox->need_update = true;
+}
+
+/** Rebuild a wibox widgets list if one of its widgets tables changed.
+ * \param wibox The wibox.
+ */
+static void
+wibox_widgets_refresh(wibox_t *wibox)
+{
+    if(wibox->need_widgets_build)
+    {
+        lua_rawgeti(globalconf.L, LUA_REGISTRYINDEX, wibox->widgets_table);
+        wibox_widgets_table_build(globalconf.L, wibox);
+        lua_pop(globalconf.L, 1);
+    }
+}
+
+/** Invalidate the wiboxes using a widgets table. Their widget list is
+ * rebuilt once, on next refresh.
+ * \param L The Lua VM state.
+ * \param idx The index of the widgets table, or of a table nested into it.
+ */
+void
+luaA_wibox_invalidate_bywtable(lua_State *L, int idx)
+{
+    luaA_wtable_owners_push(L);
+    lua_pushvalue(L, idx);
+    lua_rawget(L, -2);
+    if(lua_istable(L, -1))
+    {
+        lua_pushnil(L);
+        while(lua_next(L, -2))
+        {
+            wibox_t *wibox = lua_touserdata(L, -2);
+            wibox->need_widgets_build = true;
+            wibox->need_update = true;
+            lua_pop(L, 1); /* remove value */
+        }
+    }
+    lua_pop(L, 2); /* remove owner set and owners table */
+}
+
 /** Delete a wibox.
  * \param wibox wibox to delete.
  */
@@ -446,6 +629,7 @@ void
 wibox_delete(wibox_t **wibox)
 {
     simplewindow_wipe(&(*wibox)->sw);
+    luaA_wibox_widgets_disown(globalconf.L, *wibox);
     luaL_unref(globalconf.L, LUA_REGISTRYINDEX, (*wibox)->widgets_table);
     widget_node_array_wipe(&(*wibox)->widgets);
     p_delete(wibox);
@@ -479,6 +663,8 @@ wibox_getbywin(xcb_window_t w)
 static void
 wibox_draw(wibox_t *wibox)
 {
+    wibox_widgets_refresh(wibox);
+
     if(wibox->isvisible)
     {
         widget_render(&wibox->widgets, &wibox->sw.ctx, wibox->sw.gc,
@@ -639,6 +825,7 @@ luaA_wibox_new(lua_State *L)
 
     w = p_new(wibox_t, 1);
     w->widgets_table = LUA_REFNIL;
+    w->widgets_owned = LUA_REFNIL;
 
     w->sw.ctx.fg = globalconf.colors.fg;
     if((buf = luaA_getopt_lstring(L, 2, "fg", NULL, &len)))
@@ -689,68 +876,6 @@ luaA_wibox_new(lua_State *L)
     return luaA_wibox_userdata_new(L, w);
 }
 
-/** Rebuild wibox widgets list.
- * \param L The Lua VM state.
- * \param wibox The wibox.
- */
-static void
-wibox_widgets_table_build(lua_State *L, wibox_t *wibox)
-{
-    widget_node_array_wipe(&wibox->widgets);
-    widget_node_array_init(&wibox->widgets);
-    luaA_table2widgets(L, &wibox->widgets);
-    wibox->mouse_over = NULL;
-    wibox->need_update = true;
-}
-
-/** Check if a wibox widget table has an item.
- * \param L The Lua VM state.
- * \param wibox The wibox.
- * \param item The item to look for.
- */
-static bool
-luaA_wibox_hasitem(lua_State *L, wibox_t *wibox, const void *item)
-{
-    bool ret = false;
-    if(wibox->widgets_table != LUA_REFNIL)
-    {
-        lua_rawgeti(globalconf.L, LUA_REGISTRYINDEX, wibox->widgets_table);
-        if(lua_topointer(L, -1) == item || luaA_hasitem(L, item))
-            ret = true;
-    }
-    return ret;
-}
-
-/** Invalidate a wibox by a Lua object (table, etc).
- * \param L The Lua VM state.
- * \param item The object identifier.
- */
-void
-luaA_wibox_invalidate_byitem(lua_State *L, const void *item)
-{
-    for(int screen = 0; screen < globalconf.nscreen; screen++)
-        for(int i = 0; i < globalconf.screens[screen].wiboxes.len; i++)
-        {
-            wibox_t *wibox = globalconf.screens[screen].wiboxes.tab[i];
-            if(luaA_wibox_hasitem(L, wibox, item))
-            {
-                /* recompute widget node list */
-                wibox_widgets_table_build(L, wibox);
-                lua_pop(L, 1); /* remove widgets table */
-            }
-
-        }
-
-    for(client_t *c = globalconf.clients; c; c = c->next)
-        if(c->titlebar && luaA_wibox_hasitem(L, c->titlebar, item))
-        {
-            /* recompute widget node list */
-            wibox_widgets_table_build(L, c->titlebar);
-            lua_pop(L, 1); /* remove widgets table */
-        }
-}
-
-
 /** Wibox object.
  * \param L The Lua VM state.
  * \return The number of elements pushed on stack.
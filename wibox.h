@@ -29,7 +29,7 @@ void wibox_refresh(void);
 
 int luaA_wibox_new(lua_State *);
 int luaA_wibox_userdata_new(lua_State *, wibox_t *);
-void luaA_wibox_invalidate_byitem(lua_State *, const void *);
+void luaA_wibox_invalidate_bywtable(lua_State *, int);
 
 void wibox_position_update(wibox_t *);
 wibox_t * wibox_getbywin(xcb_window_t);
@@ -23,6 +23,7 @@
 #include <math.h>
 
 #include "widget.h"
+#include "timeseries.h"
 #include "common/tokenize.h"
 
 extern awesome_t globalconf;
@@ -47,16 +48,23 @@ typedef struct
     /* markers... */
     /** Index of current (new) value */
     int index;
-    /** Index of the actual maximum value */
-    int max_index;
+    /** Indexes of the decreasing maximum values of the window, as a ring
+     * of d->size elements: the first one is the index of the maximum */
+    int *max_queue;
+    int max_queue_first, max_queue_len;
     /** Pointer to current maximum value itself */
     float current_max;
     /** Draw style of according index */
     plot_style_t draw_style;
     /** Keeps the calculated values (line-length); */
     int *lines;
-    /** Actual values */
+    /** Maximum value and box height the lines have been calculated with */
+    float lines_max;
+    int lines_height;
+    /** Actual values, NULL if they are read from a time series */
     float *values;
+    /** Time series the values are read from */
+    timeseries_t *ts;
     /** Color of them */
     xcolor_t color_start;
     /** Color at middle of graph */
@@ -65,6 +73,12 @@ typedef struct
     xcolor_t pcolor_end;
     /** Create a vertical color gradient */
     bool vertical_gradient;
+    /** Offscreen surface with the plot rendered on it */
+    cairo_surface_t *surface;
+    /** Number of values added since the surface has been updated */
+    int pending;
+    /** The surface has to be fully redrawn */
+    bool need_rebuild;
 } plot_t;
 
 static void
@@ -73,6 +87,9 @@ plot_delete(plot_t *g)
     p_delete(&g->title);
     p_delete(&g->lines);
     p_delete(&g->values);
+    p_delete(&g->max_queue);
+    if(g->surface)
+        cairo_surface_destroy(g->surface);
 }
 
 DO_ARRAY(plot_t, plot, plot_delete)
@@ -100,6 +117,10 @@ typedef struct
     int *draw_to;
     /** Graph list */
     plot_array_t plots;
+    /** Cached background and border */
+    cairo_surface_t *chrome;
+    /** The chrome must be rendered again */
+    bool chrome_dirty;
 } graph_data_t;
 
 /** Add a plot to a graph.
@@ -117,7 +138,8 @@ graph_plot_add(graph_data_t *d, const char *title)
     plot.title = a_strdup(title);
     plot.values = p_new(float, d->size);
     plot.lines = p_new(int, d->size);
-    plot.max_value = 100.0;
+    plot.max_queue = p_new(int, d->size);
+    plot.max_value = plot.current_max = 100.0;
     plot.color_start = globalconf.colors.fg;
     plot.vertical_gradient = true;
 
@@ -126,6 +148,112 @@ graph_plot_add(graph_data_t *d, const char *title)
     return &d->plots.tab[d->plots.len - 1];
 }
 
+/** Ask for all plots of a graph to be fully redrawn.
+ * \param d The graph private data.
+ */
+static void
+graph_plots_rebuild(graph_data_t *d)
+{
+    for(int i = 0; i < d->plots.len; i++)
+        d->plots.tab[i].need_rebuild = true;
+}
+
+/** Get a value of a plot.
+ * \param plot The plot.
+ * \param size The number of values of the plot.
+ * \param idx The value index.
+ * \return The value.
+ */
+static inline float
+graph_plot_value(plot_t *plot, int size, int idx)
+{
+    if(plot->ts)
+        return MAX(timeseries_get(plot->ts, (plot->index - idx + size) % size), 0);
+    return plot->values[idx];
+}
+
+/** Append a value to the maximum values queue of a plot.
+ * \param plot The plot.
+ * \param size The number of values of the plot.
+ * \param idx The value index.
+ */
+static void
+graph_plot_max_append(plot_t *plot, int size, int idx)
+{
+    /* lower values cannot be the maximum anymore */
+    while(plot->max_queue_len
+          && graph_plot_value(plot, size, plot->max_queue[(plot->max_queue_first + plot->max_queue_len - 1) % size])
+             <= graph_plot_value(plot, size, idx))
+        plot->max_queue_len--;
+
+    plot->max_queue[(plot->max_queue_first + plot->max_queue_len++) % size] = idx;
+}
+
+/** Push the newest value of a plot in its maximum values queue, removing the
+ * value which just left the window. This is amortized O(1).
+ * \param plot The plot.
+ * \param size The number of values of the plot.
+ */
+static void
+graph_plot_max_push(plot_t *plot, int size)
+{
+    /* a bound plot also loses the values its time series does not keep */
+    while(plot->max_queue_len
+          && (plot->max_queue[plot->max_queue_first] == plot->index
+              || (plot->ts && (plot->index - plot->max_queue[plot->max_queue_first] + size) % size
+                              >= plot->ts->size)))
+    {
+        plot->max_queue_first = (plot->max_queue_first + 1) % size;
+        plot->max_queue_len--;
+    }
+
+    graph_plot_max_append(plot, size, plot->index);
+}
+
+/** Rebuild the maximum values queue of a plot from all its values.
+ * \param plot The plot.
+ * \param size The number of values of the plot.
+ */
+static void
+graph_plot_max_rebuild(plot_t *plot, int size)
+{
+    plot->max_queue_first = plot->max_queue_len = 0;
+
+    /* from the oldest value to the newest */
+    for(int i = 1; i <= size; i++)
+        graph_plot_max_append(plot, size, (plot->index + i) % size);
+}
+
+/** Compute the value representing a full plot.
+ * \param plot The plot.
+ * \param size The number of values of the plot.
+ */
+static void
+graph_plot_max_update(plot_t *plot, int size)
+{
+    if(plot->scale && plot->max_queue_len)
+        plot->current_max = MAX(graph_plot_value(plot, size, plot->max_queue[plot->max_queue_first]),
+                                plot->max_value);
+    else
+        plot->current_max = plot->max_value;
+}
+
+/** Compute the line length of a value.
+ * \param plot The plot.
+ * \param value The value.
+ * \param height The box height.
+ * \return The line length.
+ */
+static inline int
+graph_plot_line(plot_t *plot, float value, int height)
+{
+    if(plot->current_max <= 0)
+        return 0;
+    if(value >= plot->current_max)
+        return height;
+    return round(value * height / plot->current_max);
+}
+
 /** Get the plot, and create one if it does not exist.
  * \param d The graph private data.
  * \param title The plot title.
@@ -160,6 +288,239 @@ graph_geometry(widget_t *widget, int screen, int height, int width)
     return geometry;
 }
 
+/** Move the content of a plot surface horizontally, clearing the columns
+ * left behind.
+ * \param surface The plot surface.
+ * \param dx The number of columns to move the content by.
+ */
+static void
+graph_plot_surface_shift(cairo_surface_t *surface, int dx)
+{
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    unsigned char *data;
+
+    cairo_surface_flush(surface);
+    data = cairo_image_surface_get_data(surface);
+
+    for(int y = 0; y < height; y++)
+    {
+        uint32_t *row = (uint32_t *) (data + y * stride);
+
+        if(dx > 0)
+        {
+            memmove(row + dx, row, (width - dx) * sizeof(uint32_t));
+            p_clear(row, dx);
+        }
+        else
+        {
+            memmove(row, row - dx, (width + dx) * sizeof(uint32_t));
+            p_clear(row + width + dx, - dx);
+        }
+    }
+
+    cairo_surface_mark_dirty(surface);
+}
+
+/** Bring the offscreen surface of a plot up to date.
+ * New values move the previous content by one pixel each, and only the new
+ * columns are drawn. The whole plot is only redrawn if it has been rescaled,
+ * resized or restyled.
+ * \param d The graph private data.
+ * \param plot The plot.
+ */
+static void
+graph_plot_update(graph_data_t *d, plot_t *plot)
+{
+    draw_context_t pctx;
+    area_t rectangle, clip;
+    vector_t color_gradient;
+    int count = plot->pending;
+
+    if(!plot->surface
+       || cairo_image_surface_get_width(plot->surface) != d->size
+       || cairo_image_surface_get_height(plot->surface) != d->box_height)
+    {
+        if(plot->surface)
+            cairo_surface_destroy(plot->surface);
+        plot->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, d->size, d->box_height);
+        plot->need_rebuild = true;
+    }
+
+    /* an horizontal gradient does not move with the values */
+    if(count && !plot->vertical_gradient
+       && (plot->pcolor_center.initialized || plot->pcolor_end.initialized))
+        plot->need_rebuild = true;
+
+    /* the lines have to be rescaled */
+    if(plot->lines_max != plot->current_max || plot->lines_height != d->box_height)
+    {
+        for(int i = 0; i < d->size; i++)
+            plot->lines[i] = graph_plot_line(plot, graph_plot_value(plot, d->size, i), d->box_height);
+        plot->lines_max = plot->current_max;
+        plot->lines_height = d->box_height;
+        plot->need_rebuild = true;
+    }
+
+    if(plot->need_rebuild)
+        count = d->size;
+    else if(!count)
+        return;
+    else if(count < d->size)
+        graph_plot_surface_shift(plot->surface, d->grow == Right ? - count : count);
+
+    count = MIN(count, d->size);
+
+    p_clear(&pctx, 1);
+    pctx.width = d->size;
+    pctx.height = d->box_height;
+    pctx.surface = plot->surface;
+    pctx.cr = cairo_create(plot->surface);
+
+    /* the plot, with the bottom left corner as starting point */
+    rectangle.x = 0;
+    rectangle.y = d->box_height;
+    rectangle.width = d->size;
+    rectangle.height = d->box_height;
+
+    /* columns to redraw: a line also goes through the old values next to
+     * the new ones */
+    clip.width = MIN(plot->draw_style == Line_Style ? count + 2 : count, d->size);
+    clip.x = d->grow == Right ? d->size - clip.width : 0;
+    cairo_rectangle(pctx.cr, clip.x, 0, clip.width, d->box_height);
+    cairo_clip(pctx.cr);
+    cairo_set_operator(pctx.cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(pctx.cr);
+    cairo_set_operator(pctx.cr, CAIRO_OPERATOR_OVER);
+
+    draw_graph_setup(&pctx); /* setup some drawing options */
+
+    /* gradient begin either left or on the right of the rectangle */
+    if(d->grow == Right)
+        color_gradient.x = rectangle.x + rectangle.width;
+    else
+        color_gradient.x = rectangle.x;
+
+    switch(plot->draw_style)
+    {
+        case Top_Style:
+          color_gradient.y = rectangle.y - rectangle.height;
+          if(plot->vertical_gradient)
+          {
+              color_gradient.x_offset = 0;
+              color_gradient.y_offset = rectangle.height;
+          }
+          else
+          {
+              color_gradient.y_offset = 0;
+
+              if(d->grow == Right)
+                  color_gradient.x_offset = - rectangle.width;
+              else
+                  color_gradient.x_offset = rectangle.width;
+          }
+
+          for(int y = 0; y < d->size; y++)
+          {
+              /* reverse values (because drawing from top) */
+              d->draw_from[y] = d->box_height; /* i.e. no smaller value -> from top of box */
+              d->draw_to[y] = d->box_height - plot->lines[y]; /* i.e. on full plot -> 0 = bottom */
+          }
+          draw_graph(&pctx, rectangle , d->draw_from, d->draw_to, plot->index, count, d->grow,
+                     color_gradient, &plot->color_start, &plot->pcolor_center, &plot->pcolor_end);
+          break;
+        case Bottom_Style:
+          color_gradient.y = rectangle.y;
+          if(plot->vertical_gradient)
+          {
+              color_gradient.x_offset = 0;
+              color_gradient.y_offset = - rectangle.height;
+          }
+          else
+          {
+              color_gradient.y_offset = 0;
+
+              if(d->grow == Right)
+                  color_gradient.x_offset = - rectangle.width;
+              else
+                  color_gradient.x_offset = rectangle.width;
+          }
+
+          p_clear(d->draw_from, d->size);
+          draw_graph(&pctx, rectangle, d->draw_from, plot->lines, plot->index, count, d->grow,
+                     color_gradient, &plot->color_start, &plot->pcolor_center, &plot->pcolor_end);
+          break;
+        case Line_Style:
+          color_gradient.y = rectangle.y;
+          if(plot->vertical_gradient)
+          {
+              color_gradient.x_offset = 0;
+              color_gradient.y_offset = -rectangle.height;
+          }
+          else
+          {
+              color_gradient.y_offset = 0;
+              if(d->grow == Right)
+                  color_gradient.x_offset = - rectangle.width;
+              else
+                  color_gradient.x_offset = rectangle.width;
+          }
+
+          /* the line through the redrawn columns depends on the values
+           * of the next ones */
+          draw_graph_line(&pctx, rectangle, plot->lines, plot->index, clip.width + 2, d->grow,
+                          color_gradient, &plot->color_start, &plot->pcolor_center, &plot->pcolor_end);
+          break;
+    }
+
+    cairo_destroy(pctx.cr);
+
+    plot->pending = 0;
+    plot->need_rebuild = false;
+}
+
+/** Render the background and the border of a graph if needed.
+ * \param d The graph private data.
+ */
+static void
+graph_chrome_update(graph_data_t *d)
+{
+    draw_context_t pctx;
+    area_t rectangle;
+
+    if(d->chrome && !d->chrome_dirty
+       && cairo_image_surface_get_width(d->chrome) == d->size + 2
+       && cairo_image_surface_get_height(d->chrome) == d->box_height + 2)
+        return;
+
+    if(d->chrome)
+        cairo_surface_destroy(d->chrome);
+    d->chrome = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, d->size + 2, d->box_height + 2);
+
+    p_clear(&pctx, 1);
+    pctx.width = d->size + 2;
+    pctx.height = d->box_height + 2;
+    pctx.cr = cairo_create(pctx.surface = d->chrome);
+
+    /* background */
+    rectangle.x = 1;
+    rectangle.y = 1;
+    rectangle.width = d->size;
+    rectangle.height = d->box_height;
+    draw_rectangle(&pctx, rectangle, 1.0, true, &d->bg);
+
+    /* border: the plots are drawn inside of it */
+    rectangle.x = 0;
+    rectangle.y = 0;
+    rectangle.width = d->size + 2;
+    rectangle.height = d->box_height + 2;
+    draw_rectangle(&pctx, rectangle, 1.0, false, &d->border_color);
+
+    cairo_destroy(pctx.cr);
+    d->chrome_dirty = false;
+}
+
 /** Draw a graph widget.
  * \param ctx The draw context.
  * \param screen The screen number.
@@ -173,10 +534,9 @@ static void
 graph_draw(widget_t *widget, draw_context_t *ctx,
            area_t geometry, int screen, wibox_t *p)
 {
-    int margin_top, y;
+    int margin_top;
     graph_data_t *d = widget->data;
     area_t rectangle;
-    vector_t color_gradient;
 
     if(!d->plots.len)
         return;
@@ -187,106 +547,28 @@ graph_draw(widget_t *widget, draw_context_t *ctx,
 
     margin_top = round((ctx->height - (d->box_height + 2)) / 2) + geometry.y;
 
-    /* draw background */
+    /* draw background and border */
+    graph_chrome_update(d);
+    cairo_set_source_surface(ctx->cr, d->chrome, geometry.x, margin_top);
+    cairo_rectangle(ctx->cr, geometry.x, margin_top, d->size + 2, d->box_height + 2);
+    cairo_fill(ctx->cr);
+
     rectangle.x = geometry.x + 1;
     rectangle.y = margin_top + 1;
     rectangle.width = d->size;
     rectangle.height = d->box_height;
-    draw_rectangle(ctx, rectangle, 1.0, true, &d->bg);
-
-    /* for plot drawing */
-    rectangle.y = margin_top + d->box_height + 1; /* bottom left corner as starting point */
-    rectangle.width = d->size; /* rectangle.height is not used */
 
-    draw_graph_setup(ctx); /* setup some drawing options */
+    if(d->size > 0 && d->box_height > 0)
+        for(int i = 0; i < d->plots.len; i++)
+        {
+            plot_t *plot = &d->plots.tab[i];
 
-    /* gradient begin either left or on the right of the rectangle */
-    if(d->grow == Right)
-        color_gradient.x = rectangle.x + rectangle.width;
-    else
-        color_gradient.x = rectangle.x;
+            graph_plot_update(d, plot);
 
-    for(int i = 0; i < d->plots.len; i++)
-    {
-        plot_t *plot = &d->plots.tab[i];
-
-        switch(plot->draw_style)
-        {
-            case Top_Style:
-              color_gradient.y = rectangle.y - rectangle.height;
-              if(plot->vertical_gradient)
-              {
-                  color_gradient.x_offset = 0;
-                  color_gradient.y_offset = rectangle.height;
-              }
-              else
-              {
-                  color_gradient.y_offset = 0;
-
-                  if(d->grow == Right)
-                      color_gradient.x_offset = - rectangle.width;
-                  else
-                      color_gradient.x_offset = rectangle.width;
-              }
-
-              for(y = 0; y < d->size; y++)
-              {
-                  /* reverse values (because drawing from top) */
-                  d->draw_from[y] = d->box_height; /* i.e. no smaller value -> from top of box */
-                  d->draw_to[y] = d->box_height - plot->lines[y]; /* i.e. on full plot -> 0 = bottom */
-              }
-              draw_graph(ctx, rectangle , d->draw_from, d->draw_to, plot->index, d->grow, color_gradient,
-                         &plot->color_start, &plot->pcolor_center, &plot->pcolor_end);
-              break;
-            case Bottom_Style:
-              color_gradient.y = rectangle.y;
-              if(plot->vertical_gradient)
-              {
-                  color_gradient.x_offset = 0;
-                  color_gradient.y_offset = - rectangle.height;
-              }
-              else
-              {
-                  color_gradient.y_offset = 0;
-
-                  if(d->grow == Right)
-                      color_gradient.x_offset = - rectangle.width;
-                  else
-                      color_gradient.x_offset = rectangle.width;
-              }
-
-              p_clear(d->draw_from, d->size);
-              draw_graph(ctx, rectangle, d->draw_from, plot->lines, plot->index, d->grow, color_gradient,
-                         &plot->color_start, &plot->pcolor_center, &plot->pcolor_end);
-              break;
-            case Line_Style:
-              color_gradient.y = rectangle.y;
-              if(plot->vertical_gradient)
-              {
-                  color_gradient.x_offset = 0;
-                  color_gradient.y_offset = -rectangle.height;
-              }
-              else
-              {
-                  color_gradient.y_offset = 0;
-                  if(d->grow == Right)
-                      color_gradient.x_offset = - rectangle.width;
-                  else
-                      color_gradient.x_offset = rectangle.width;
-              }
-
-              draw_graph_line(ctx, rectangle, plot->lines, plot->index, d->grow, color_gradient,
-                              &plot->color_start, &plot->pcolor_center, &plot->pcolor_end);
-              break;
+            cairo_set_source_surface(ctx->cr, plot->surface, rectangle.x, rectangle.y);
+            cairo_rectangle(ctx->cr, rectangle.x, rectangle.y, rectangle.width, rectangle.height);
+            cairo_fill(ctx->cr);
         }
-    }
-
-    /* draw border (after line-drawing, what paints 0-values to the border) */
-    rectangle.x = geometry.x;
-    rectangle.y = margin_top;
-    rectangle.width = d->size + 2;
-    rectangle.height = d->box_height + 2;
-    draw_rectangle(ctx, rectangle, 1.0, false, &d->border_color);
 }
 
 /** Set various plot graph properties.
@@ -302,7 +584,6 @@ luaA_graph_plot_properties_set(lua_State *L)
 {
     widget_t **widget = luaA_checkudata(L, 1, "widget");
     graph_data_t *d = (*widget)->data;
-    float max_value;
     const char *title, *buf;
     size_t len;
     plot_t *plot = NULL;
@@ -326,9 +607,10 @@ luaA_graph_plot_properties_set(lua_State *L)
     plot->vertical_gradient = luaA_getopt_boolean(L, 3, "vertical_gradient", plot->vertical_gradient);
     plot->scale = luaA_getopt_boolean(L, 3, "scale", plot->scale);
 
-    max_value = luaA_getopt_number(L, 3, "max_value", plot->max_value);
-    if(max_value != plot->max_value)
-        plot->max_value = plot->current_max = max_value;
+    plot->max_value = luaA_getopt_number(L, 3, "max_value", plot->max_value);
+
+    graph_plot_max_rebuild(plot, d->size);
+    graph_plot_max_update(plot, d->size);
 
     if((buf = luaA_getopt_lstring(L, 3, "style", NULL, &len)))
         switch (a_tokenize(buf, len))
@@ -349,76 +631,105 @@ luaA_graph_plot_properties_set(lua_State *L)
     for(i = 0; i <= reqs_nbr; i++)
         xcolor_init_reply(reqs[i]);
 
+    plot->need_rebuild = true;
+
     widget_invalidate_bywidget(*widget);
 
     return 0;
 }
 
 /** Add data to a plot.
- * \param l The Lua VM state.
- * \return The number of elements pushed on stack.
- * \luastack
- * \lvalue A widget.
- * \lparam A plot name.
- * \lparam A data value.
+ * \param widget The graph widget.
+ * \param title The plot name.
+ * \param value The value.
  */
-static int
-luaA_graph_plot_data_add(lua_State *L)
+static void
+graph_plot_data_add(widget_t *widget, const char *title, float value)
 {
-    widget_t **widget = luaA_checkudata(L, 1, "widget");
-    graph_data_t *d = (*widget)->data;
-    plot_t *plot = NULL;
-    const char *title = luaL_checkstring(L, 2);
-    float value;
-    int i;
-
-    plot = graph_plot_get(d, title);
-
-    /* assign incoming value */
-    value = MAX(luaL_checknumber(L, 3), 0);
+    graph_data_t *d = widget->data;
+    plot_t *plot = graph_plot_get(d, title);
 
     if(++plot->index >= d->size) /* cycle inside the array */
         plot->index = 0;
 
+    /* a bound plot reads the value from its time series */
+    if(!plot->ts)
+        plot->values[plot->index] = MAX(value, 0);
+
     if(plot->scale) /* scale option is true */
     {
-        plot->values[plot->index] = value;
+        graph_plot_max_push(plot, d->size);
+        graph_plot_max_update(plot, d->size);
+    }
 
-        if(value > plot->current_max) /* a new maximum value found */
-        {
-            plot->max_index = plot->index;
-            plot->current_max = value;
+    /* if the maximum changed, all lines are rescaled at once on next draw */
+    if(plot->current_max == plot->lines_max && d->box_height == plot->lines_height)
+        plot->lines[plot->index] = graph_plot_line(plot, graph_plot_value(plot, d->size, plot->index),
+                                                   d->box_height);
 
-            /* recalculate */
-            for (i = 0; i < d->size; i++)
-                plot->lines[i] = round(plot->values[i] * d->box_height / plot->current_max);
-        }
-        /* old max_index reached + current_max > normal, re-check/generate */
-        else if(plot->max_index == plot->index
-                && plot->current_max > plot->max_value)
-        {
-            /* find the new max */
-            for(i = 0; i < d->size; i++)
-                if(plot->values[i] > plot->values[plot->max_index])
-                    plot->max_index = i;
+    plot->pending++;
+}
 
-            plot->current_max = MAX(plot->values[plot->max_index], plot->max_value);
+/** Make a plot read its values from a time series, or keep its own values.
+ * \param widget The graph widget.
+ * \param title The plot name.
+ * \param ts The time series, or NULL.
+ */
+static void
+graph_plot_data_bind(widget_t *widget, const char *title, timeseries_t *ts)
+{
+    graph_data_t *d = widget->data;
+    plot_t *plot = graph_plot_get(d, title);
 
-            /* recalculate */
-            for(i = 0; i < d->size; i++)
-                plot->lines[i] = round(plot->values[i] * d->box_height / plot->current_max);
+    if(plot->ts == ts)
+        return;
+
+    if(plot->ts)
+    {
+        /* keep the values the plot was showing */
+        if(!ts)
+        {
+            plot->values = p_new(float, d->size);
+            for(int i = 0; i < d->size; i++)
+                plot->values[i] = graph_plot_value(plot, d->size, i);
         }
-        else
-            plot->lines[plot->index] = round(value * d->box_height / plot->current_max);
+        timeseries_binding_remove(plot->ts, widget, title);
+        timeseries_unref(&plot->ts);
+        plot->ts = NULL;
     }
-    else /* scale option is false - limit to d->box_height */
+
+    if(ts)
     {
-        if(value < plot->max_value)
-            plot->lines[plot->index] = round(value * d->box_height / plot->max_value);
-        else
-            plot->lines[plot->index] = d->box_height;
+        p_delete(&plot->values);
+        plot->ts = timeseries_ref(&ts);
+        timeseries_binding_add(ts, widget, title);
     }
 
+    graph_plot_max_rebuild(plot, d->size);
+    graph_plot_max_update(plot, d->size);
+    /* force the lines to be computed again */
+    plot->lines_height = -1;
+}
+
+/** Add data to a plot.
+ * \param l The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A widget.
+ * \lparam A plot name.
+ * \lparam A data value.
+ */
+static int
+luaA_graph_plot_data_add(lua_State *L)
+{
+    widget_t **widget = luaA_checkudata(L, 1, "widget");
+    const char *title = luaL_checkstring(L, 2);
+
+    if(graph_plot_get((*widget)->data, title)->ts)
+        luaL_error(L, "plot is bound to a time series");
+
+    graph_plot_data_add(*widget, title, luaL_checknumber(L, 3));
+
     widget_invalidate_bywidget(*widget);
 
     return 0;
@@ -509,16 +820,25 @@ luaA_graph_newindex(lua_State *L, awesome_token_t token)
         {
             d->width = width;
             d->size = d->width - 2;
+            p_realloc(&d->draw_from, d->size);
+            p_realloc(&d->draw_to, d->size);
             for(int i = 0; i < d->plots.len; i++)
             {
                 plot_t *plot = &d->plots.tab[i];
-                p_realloc(&plot->values, d->size);
                 p_realloc(&plot->lines, d->size);
-                p_clear(plot->values, d->size);
+                p_realloc(&plot->max_queue, d->size);
                 p_clear(plot->lines, d->size);
+                /* a bound plot still shows the values of its time series */
+                if(plot->ts)
+                    plot->lines_height = -1;
+                else
+                {
+                    p_realloc(&plot->values, d->size);
+                    p_clear(plot->values, d->size);
+                }
                 plot->index = 0;
-                plot->current_max =  0;
-                plot->max_index =  0;
+                graph_plot_max_rebuild(plot, d->size);
+                graph_plot_max_update(plot, d->size);
             }
         }
         else
@@ -528,7 +848,10 @@ luaA_graph_newindex(lua_State *L, awesome_token_t token)
         if((buf = luaL_checklstring(L, 3, &len)))
         {
             if(xcolor_init_reply(xcolor_init_unchecked(&color, buf, len)))
+            {
                 d->bg = color;
+                d->chrome_dirty = true;
+            }
             else
                 return 0;
         }
@@ -537,7 +860,10 @@ luaA_graph_newindex(lua_State *L, awesome_token_t token)
         if((buf = luaL_checklstring(L, 3, &len)))
         {
             if(xcolor_init_reply(xcolor_init_unchecked(&color, buf, len)))
+            {
                 d->border_color = color;
+                d->chrome_dirty = true;
+            }
             else
                 return 0;
         }
@@ -549,6 +875,7 @@ luaA_graph_newindex(lua_State *L, awesome_token_t token)
           case Left:
           case Right:
             d->grow = pos;
+            graph_plots_rebuild(d);
             break;
           default:
             return 0;
@@ -571,7 +898,16 @@ graph_destructor(widget_t *widget)
 {
     graph_data_t *d = widget->data;
 
+    for(int i = 0; i < d->plots.len; i++)
+        if(d->plots.tab[i].ts)
+        {
+            timeseries_binding_remove(d->plots.tab[i].ts, widget, d->plots.tab[i].title);
+            timeseries_unref(&d->plots.tab[i].ts);
+        }
+
     plot_array_wipe(&d->plots);
+    if(d->chrome)
+        cairo_surface_destroy(d->chrome);
     p_delete(&d->draw_from);
     p_delete(&d->draw_to);
     p_delete(&d);
@@ -594,6 +930,8 @@ graph_new(alignment_t align)
     w->index = luaA_graph_index;
     w->newindex = luaA_graph_newindex;
     w->destructor = graph_destructor;
+    w->data_add = graph_plot_data_add;
+    w->data_bind = graph_plot_data_bind;
     w->align = align;
     w->geometry = graph_geometry;
     d = w->data = p_new(graph_data_t, 1);
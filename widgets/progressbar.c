@@ -22,6 +22,7 @@
 
 #include "common/tokenize.h"
 #include "widget.h"
+#include "timeseries.h"
 
 extern awesome_t globalconf;
 
@@ -36,6 +37,8 @@ typedef struct
     float max_value;
     /** Pointer to value */
     float value;
+    /** Time series the value is read from */
+    timeseries_t *ts;
     /** Reverse filling */
     bool reverse;
     /** Foreground color */
@@ -50,6 +53,12 @@ typedef struct
     xcolor_t bg;
     /** Border color */
     xcolor_t border_color;
+    /** Cached renderings of the empty and of the full bar, with border */
+    cairo_surface_t *chrome_empty, *chrome_full;
+    /** Bar size and tick unit the chrome has been rendered for */
+    int chrome_width, chrome_height, chrome_unit;
+    /** The chrome must be rendered again */
+    bool chrome_dirty;
 } bar_t;
 
 /** Delete a bar.
@@ -59,6 +68,10 @@ static void
 bar_delete(bar_t *bar)
 {
     p_delete(&bar->title);
+    if(bar->chrome_empty)
+        cairo_surface_destroy(bar->chrome_empty);
+    if(bar->chrome_full)
+        cairo_surface_destroy(bar->chrome_full);
 }
 
 DO_ARRAY(bar_t, bar, bar_delete)
@@ -111,6 +124,16 @@ progressbar_bar_add(bar_array_t *bars, const char *title)
     return &bars->tab[bars->len - 1];
 }
 
+/** Ask for the chrome of all bars to be rendered again.
+ * \param d The progressbar private data.
+ */
+static void
+progressbar_chrome_invalidate(progressbar_data_t *d)
+{
+    for(int i = 0; i < d->bars.len; i++)
+        d->bars.tab[i].chrome_dirty = true;
+}
+
 /** Get the bar, and create one if it does not exist.
  * \param bars The bar array.
  * \param title The bar title.
@@ -162,6 +185,317 @@ progressbar_geometry(widget_t *widget, int screen, int height, int width)
     return geometry;
 }
 
+/** Get the value of a bar.
+ * \param bar The bar.
+ * \return The value.
+ */
+static inline float
+progressbar_bar_value(bar_t *bar)
+{
+    if(bar->ts && bar->ts->len)
+        return MAX(bar->min_value, MIN(bar->max_value, timeseries_get(bar->ts, 0)));
+    return bar->value;
+}
+
+/** Compute the length of the filled part of a bar.
+ * \param d The progressbar private data.
+ * \param bar The bar.
+ * \param length The bar length.
+ * \param unit The tick unit (tick + gap).
+ * \return The filled length in pixels.
+ */
+static int
+progressbar_bar_progress(progressbar_data_t *d, bar_t *bar, int length, int unit)
+{
+    int values_ticks;
+    float value = progressbar_bar_value(bar);
+
+    if(d->ticks_count && d->ticks_gap)
+    {
+        /* +0.5 rounds up ticks -> turn on a tick when half of it is reached */
+        values_ticks = (int)(d->ticks_count * (value - bar->min_value)
+                             / (bar->max_value - bar->min_value) + 0.5);
+        if(values_ticks)
+            return values_ticks * unit - d->ticks_gap;
+        return 0;
+    }
+
+    /* e.g.: min = 50; max = 56; 53 should show 50% graph
+     * (53(val) - 50(min) / (56(max) - 50(min) = 3 / 5 = 0.5 = 50%
+     * round that ( + 0.5 and (int)) and finally multiply with length
+     */
+    return (int) (length * (value - bar->min_value)
+                  / (bar->max_value - bar->min_value) + 0.5);
+}
+
+/** Render a bar with its border and ticks.
+ * \param ctx The draw context.
+ * \param d The progressbar private data.
+ * \param bar The bar.
+ * \param pb The bar geometry, inside the border.
+ * \param pb_progress The filled length in pixels.
+ * \param unit The tick unit (tick + gap).
+ */
+static void
+progressbar_bar_render(draw_context_t *ctx, progressbar_data_t *d, bar_t *bar,
+                       area_t pb, int pb_progress, int unit)
+{
+    area_t rectangle;
+    vector_t color_gradient;
+
+    /* for a 'reversed' progressbar:
+     * basic progressbar:
+     * 1. the full space gets the size of the formerly empty one
+     * 2. the pattern must be mirrored
+     * 3. the formerly 'empty' side gets drawed with fg colors, the 'full' with bg-color
+     *
+     * ticks:
+     * 1. round the values to a full tick accordingly
+     * 2. finally draw the gaps
+     */
+
+    if(d->border_width)
+    {
+        /* border rectangle */
+        rectangle.x = pb.x - d->border_width - d->border_padding;
+        rectangle.y = pb.y - d->border_width - d->border_padding;
+        rectangle.width = pb.width + 2 * (d->border_padding + d->border_width);
+        rectangle.height = pb.height + 2 * (d->border_padding + d->border_width);
+
+        if(d->border_padding)
+            draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
+        draw_rectangle(ctx, rectangle, d->border_width, false, &bar->border_color);
+    }
+
+    if(d->vertical)
+    {
+        color_gradient.x = pb.x;
+        color_gradient.x_offset =  0;
+        color_gradient.y = pb.y;
+
+        /* new value/progress in px + pattern setup */
+        if(bar->reverse)
+        {
+            /* invert: top with bottom part */
+            pb_progress = pb.height - pb_progress;
+            color_gradient.y_offset = pb.height;
+        }
+        else
+        {
+            /* bottom to top */
+            color_gradient.y += pb.height;
+            color_gradient.y_offset = - pb.height;
+        }
+
+        /* bottom part */
+        if(pb_progress > 0)
+        {
+            rectangle.x = pb.x;
+            rectangle.y = pb.y + pb.height - pb_progress;
+            rectangle.width = pb.width;
+            rectangle.height = pb_progress;
+
+            /* fg color */
+            if(bar->reverse)
+                draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
+            else
+                draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
+                                        &bar->fg, &bar->fg_center, &bar->fg_end);
+        }
+
+        /* top part */
+        if(pb.height - pb_progress > 0) /* not filled area */
+        {
+            rectangle.x = pb.x;
+            rectangle.y = pb.y;
+            rectangle.width = pb.width;
+            rectangle.height = pb.height - pb_progress;
+
+            /* bg color */
+            if(bar->reverse)
+                draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
+                                        &bar->fg, &bar->fg_center, &bar->fg_end);
+            else
+                draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
+        }
+        /* draw gaps TODO: improve e.g all in one */
+        if(d->ticks_count && d->ticks_gap)
+        {
+            rectangle.width = pb.width;
+            rectangle.height = d->ticks_gap;
+            rectangle.x = pb.x;
+            for(rectangle.y = pb.y + (unit - d->ticks_gap);
+                    pb.y + pb.height - d->ticks_gap >= rectangle.y;
+                    rectangle.y += unit)
+                draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
+        }
+    }
+    else /* a horizontal progressbar */
+    {
+        color_gradient.y = pb.y;
+        color_gradient.y_offset = 0;
+        color_gradient.x = pb.x;
+
+        /* new value/progress in px + pattern setup */
+        if(bar->reverse)
+        {
+            /* reverse: right to left */
+            pb_progress = pb.width - pb_progress;
+            color_gradient.x += pb.width;
+            color_gradient.x_offset = - pb.width;
+        }
+        else
+            /* left to right */
+            color_gradient.x_offset = pb.width;
+
+        /* left part */
+        if(pb_progress > 0)
+        {
+            rectangle.x = pb.x;
+            rectangle.y = pb.y;
+            rectangle.width = pb_progress;
+            rectangle.height = pb.height;
+
+            /* fg color */
+            if(bar->reverse)
+                draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
+            else
+                draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
+                                        &bar->fg, &bar->fg_center, &bar->fg_end);
+        }
+
+        /* right part */
+        if(pb.width - pb_progress > 0)
+        {
+            rectangle.x = pb.x + pb_progress;
+            rectangle.y = pb.y;
+            rectangle.width = pb.width - pb_progress;
+            rectangle.height = pb.height;
+
+            /* bg color */
+            if(bar->reverse)
+                draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
+                                        &bar->fg, &bar->fg_center, &bar->fg_end);
+            else
+                draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
+        }
+        /* draw gaps TODO: improve e.g all in one */
+        if(d->ticks_count && d->ticks_gap)
+        {
+            rectangle.width = d->ticks_gap;
+            rectangle.height = pb.height;
+            rectangle.y = pb.y;
+            for(rectangle.x = pb.x + (unit - d->ticks_gap);
+                    pb.x + pb.width - d->ticks_gap >= rectangle.x;
+                    rectangle.x += unit)
+                draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
+        }
+    }
+}
+
+/** Render the chrome of a bar if needed: the whole bar with its border,
+ * ticks and gradient, once empty and once full.
+ * \param d The progressbar private data.
+ * \param bar The bar.
+ * \param pb_width The bar width, inside the border.
+ * \param pb_height The bar height, inside the border.
+ * \param unit The tick unit (tick + gap).
+ */
+static void
+progressbar_bar_chrome_update(progressbar_data_t *d, bar_t *bar,
+                              int pb_width, int pb_height, int unit)
+{
+    int margin = d->border_width + d->border_padding;
+    area_t pb = { margin, margin, pb_width, pb_height };
+    draw_context_t pctx;
+
+    if(bar->chrome_empty && !bar->chrome_dirty
+       && bar->chrome_width == pb_width
+       && bar->chrome_height == pb_height
+       && bar->chrome_unit == unit)
+        return;
+
+    if(bar->chrome_empty)
+        cairo_surface_destroy(bar->chrome_empty);
+    if(bar->chrome_full)
+        cairo_surface_destroy(bar->chrome_full);
+
+    bar->chrome_empty = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                   pb_width + 2 * margin,
+                                                   pb_height + 2 * margin);
+    bar->chrome_full = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                  pb_width + 2 * margin,
+                                                  pb_height + 2 * margin);
+
+    p_clear(&pctx, 1);
+    pctx.width = pb_width + 2 * margin;
+    pctx.height = pb_height + 2 * margin;
+
+    pctx.cr = cairo_create(pctx.surface = bar->chrome_empty);
+    progressbar_bar_render(&pctx, d, bar, pb, 0, unit);
+    cairo_destroy(pctx.cr);
+
+    pctx.cr = cairo_create(pctx.surface = bar->chrome_full);
+    progressbar_bar_render(&pctx, d, bar, pb, d->vertical ? pb_height : pb_width, unit);
+    cairo_destroy(pctx.cr);
+
+    bar->chrome_width = pb_width;
+    bar->chrome_height = pb_height;
+    bar->chrome_unit = unit;
+    bar->chrome_dirty = false;
+}
+
+/** Draw a bar from its chrome: the full bar where it is filled, the empty
+ * one elsewhere.
+ * \param ctx The draw context.
+ * \param d The progressbar private data.
+ * \param bar The bar.
+ * \param pb The bar geometry, inside the border.
+ * \param unit The tick unit (tick + gap).
+ */
+static void
+progressbar_bar_draw(draw_context_t *ctx, progressbar_data_t *d, bar_t *bar,
+                     area_t pb, int unit)
+{
+    int margin = d->border_width + d->border_padding;
+    int length = d->vertical ? pb.height : pb.width;
+    int pb_progress = MAX(0, MIN(length, progressbar_bar_progress(d, bar, length, unit)));
+    area_t outer = { pb.x - margin, pb.y - margin, pb.width + 2 * margin, pb.height + 2 * margin };
+    area_t fill = pb;
+
+    if(pb.width <= 0 || pb.height <= 0)
+        return;
+
+    progressbar_bar_chrome_update(d, bar, pb.width, pb.height, unit);
+
+    if(d->vertical)
+    {
+        fill.height = pb_progress;
+        if(!bar->reverse)
+            fill.y += pb.height - pb_progress;
+    }
+    else
+    {
+        fill.width = pb_progress;
+        if(bar->reverse)
+            fill.x += pb.width - pb_progress;
+    }
+
+    cairo_set_fill_rule(ctx->cr, CAIRO_FILL_RULE_EVEN_ODD);
+    cairo_set_source_surface(ctx->cr, bar->chrome_empty, outer.x, outer.y);
+    cairo_rectangle(ctx->cr, outer.x, outer.y, outer.width, outer.height);
+    cairo_rectangle(ctx->cr, fill.x, fill.y, fill.width, fill.height);
+    cairo_fill(ctx->cr);
+    cairo_set_fill_rule(ctx->cr, CAIRO_FILL_RULE_WINDING);
+
+    if(pb_progress > 0)
+    {
+        cairo_set_source_surface(ctx->cr, bar->chrome_full, outer.x, outer.y);
+        cairo_rectangle(ctx->cr, fill.x, fill.y, fill.width, fill.height);
+        cairo_fill(ctx->cr);
+    }
+}
+
 /** Draw a progressbar.
  * \param ctx The draw context.
  * \param screen The screen we're drawing for.
@@ -176,26 +510,14 @@ progressbar_draw(widget_t *widget, draw_context_t *ctx, area_t geometry,
                  int screen, wibox_t *p)
 {
     /* pb_.. values points to the widget inside a potential border */
-    int values_ticks, pb_x, pb_y, pb_height, pb_width, pb_progress, pb_offset;
+    int pb_x, pb_y, pb_height, pb_width, pb_offset;
     int unit = 0; /* tick + gap */
-    area_t rectangle;
-    vector_t color_gradient;
+    area_t pb;
     progressbar_data_t *d = widget->data;
 
     if(!d->bars.len)
         return;
 
-    /* for a 'reversed' progressbar:
-     * basic progressbar:
-     * 1. the full space gets the size of the formerly empty one
-     * 2. the pattern must be mirrored
-     * 3. the formerly 'empty' side gets drawed with fg colors, the 'full' with bg-color
-     *
-     * ticks:
-     * 1. round the values to a full tick accordingly
-     * 2. finally draw the gaps
-     */
-
     pb_x = geometry.x + d->border_width + d->border_padding;
     pb_offset = 0;
 
@@ -204,8 +526,6 @@ progressbar_draw(widget_t *widget, draw_context_t *ctx, area_t geometry,
         pb_width = (int) ((d->width - 2 * (d->border_width + d->border_padding) * d->bars.len
                    - d->gap * (d->bars.len - 1)) / d->bars.len);
 
-        /** \todo maybe prevent to calculate that stuff below over and over again
-         * (->use static-values) */
         pb_height = (int) (ctx->height * d->height + 0.5)
                     - 2 * (d->border_width + d->border_padding);
         if(d->ticks_count && d->ticks_gap)
@@ -220,97 +540,11 @@ progressbar_draw(widget_t *widget, draw_context_t *ctx, area_t geometry,
 
         for(int i = 0; i < d->bars.len; i++)
         {
-            bar_t *bar = &d->bars.tab[i];
-            if(d->ticks_count && d->ticks_gap)
-            {
-                values_ticks = (int)(d->ticks_count * (bar->value - bar->min_value)
-                               / (bar->max_value - bar->min_value) + 0.5);
-                if(values_ticks)
-                    pb_progress = values_ticks * unit - d->ticks_gap;
-                else
-                    pb_progress = 0;
-            }
-            else
-                /* e.g.: min = 50; max = 56; 53 should show 50% graph
-                 * (53(val) - 50(min) / (56(max) - 50(min) = 3 / 5 = 0.5 = 50%
-                 * round that ( + 0.5 and (int)) and finally multiply with height
-                 */
-                pb_progress = (int) (pb_height * (bar->value - bar->min_value)
-                                     / (bar->max_value - bar->min_value) + 0.5);
-
-            if(d->border_width)
-            {
-                /* border rectangle */
-                rectangle.x = pb_x + pb_offset - d->border_width - d->border_padding;
-                rectangle.y = pb_y - d->border_width - d->border_padding;
-                rectangle.width = pb_width + 2 * (d->border_padding + d->border_width);
-                rectangle.height = pb_height + 2 * (d->border_padding + d->border_width);
-
-                if(d->border_padding)
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
-                draw_rectangle(ctx, rectangle, d->border_width, false, &bar->border_color);
-            }
-
-            color_gradient.x = pb_x;
-            color_gradient.x_offset =  0;
-            color_gradient.y = pb_y;
-
-            /* new value/progress in px + pattern setup */
-            if(bar->reverse)
-            {
-                /* invert: top with bottom part */
-                pb_progress = pb_height - pb_progress;
-                color_gradient.y_offset = pb_height;
-            }
-            else
-            {
-                /* bottom to top */
-                color_gradient.y += pb_height;
-                color_gradient.y_offset = - pb_height;
-            }
-
-            /* bottom part */
-            if(pb_progress > 0)
-            {
-                rectangle.x = pb_x + pb_offset;
-                rectangle.y = pb_y + pb_height - pb_progress;
-                rectangle.width = pb_width;
-                rectangle.height = pb_progress;
-
-                /* fg color */
-                if(bar->reverse)
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
-                else
-                    draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
-                                            &bar->fg, &bar->fg_center, &bar->fg_end);
-            }
-
-            /* top part */
-            if(pb_height - pb_progress > 0) /* not filled area */
-            {
-                rectangle.x = pb_x + pb_offset;
-                rectangle.y = pb_y;
-                rectangle.width = pb_width;
-                rectangle.height = pb_height - pb_progress;
-
-                /* bg color */
-                if(bar->reverse)
-                    draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
-                                            &bar->fg, &bar->fg_center, &bar->fg_end);
-                else
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
-            }
-            /* draw gaps TODO: improve e.g all in one */
-            if(d->ticks_count && d->ticks_gap)
-            {
-                rectangle.width = pb_width;
-                rectangle.height = d->ticks_gap;
-                rectangle.x = pb_x + pb_offset;
-                for(rectangle.y = pb_y + (unit - d->ticks_gap);
-                        pb_y + pb_height - d->ticks_gap >= rectangle.y;
-                        rectangle.y += unit)
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
-            }
+            pb.x = pb_x + pb_offset;
+            pb.y = pb_y;
+            pb.width = pb_width;
+            pb.height = pb_height;
+            progressbar_bar_draw(ctx, d, &d->bars.tab[i], pb, unit);
             pb_offset += pb_width + d->gap + 2 * (d->border_width + d->border_padding);
         }
     }
@@ -332,93 +566,11 @@ progressbar_draw(widget_t *widget, draw_context_t *ctx, area_t geometry,
 
         for(int i = 0; i < d->bars.len; i++)
         {
-            bar_t *bar = &d->bars.tab[i];
-            if(d->ticks_count && d->ticks_gap)
-            {
-                /* +0.5 rounds up ticks -> turn on a tick when half of it is reached */
-                values_ticks = (int)(d->ticks_count * (bar->value - bar->min_value)
-                                     / (bar->max_value - bar->min_value) + 0.5);
-                if(values_ticks)
-                    pb_progress = values_ticks * unit - d->ticks_gap;
-                else
-                    pb_progress = 0;
-            }
-            else
-                pb_progress = (int) (pb_width * (bar->value - bar->min_value)
-                                     / (bar->max_value - bar->min_value) + 0.5);
-
-            if(d->border_width)
-            {
-                /* border rectangle */
-                rectangle.x = pb_x - d->border_width - d->border_padding;
-                rectangle.y = pb_y + pb_offset - d->border_width - d->border_padding;
-                rectangle.width = pb_width + 2 * (d->border_padding + d->border_width);
-                rectangle.height = pb_height + 2 * (d->border_padding + d->border_width);
-
-                if(d->border_padding)
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
-                draw_rectangle(ctx, rectangle, d->border_width, false, &bar->border_color);
-            }
-
-            color_gradient.y = pb_y;
-            color_gradient.y_offset = 0;
-            color_gradient.x = pb_x;
-
-            /* new value/progress in px + pattern setup */
-            if(bar->reverse)
-            {
-                /* reverse: right to left */
-                pb_progress = pb_width - pb_progress;
-                color_gradient.x += pb_width;
-                color_gradient.x_offset = - pb_width;
-            }
-            else
-                /* left to right */
-                color_gradient.x_offset = pb_width;
-
-            /* left part */
-            if(pb_progress > 0)
-            {
-                rectangle.x = pb_x;
-                rectangle.y = pb_y + pb_offset;
-                rectangle.width = pb_progress;
-                rectangle.height = pb_height;
-
-                /* fg color */
-                if(bar->reverse)
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
-                else
-                    draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
-                                            &bar->fg, &bar->fg_center, &bar->fg_end);
-            }
-
-            /* right part */
-            if(pb_width - pb_progress > 0)
-            {
-                rectangle.x = pb_x + pb_progress;
-                rectangle.y = pb_y +  pb_offset;
-                rectangle.width = pb_width - pb_progress;
-                rectangle.height = pb_height;
-
-                /* bg color */
-                if(bar->reverse)
-                    draw_rectangle_gradient(ctx, rectangle, 1.0, true, color_gradient,
-                                            &bar->fg, &bar->fg_center, &bar->fg_end);
-                else
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->fg_off);
-            }
-            /* draw gaps TODO: improve e.g all in one */
-            if(d->ticks_count && d->ticks_gap)
-            {
-                rectangle.width = d->ticks_gap;
-                rectangle.height = pb_height;
-                rectangle.y = pb_y + pb_offset;
-                for(rectangle.x = pb_x + (unit - d->ticks_gap);
-                        pb_x + pb_width - d->ticks_gap >= rectangle.x;
-                        rectangle.x += unit)
-                    draw_rectangle(ctx, rectangle, 1.0, true, &bar->bg);
-            }
-
+            pb.x = pb_x;
+            pb.y = pb_y + pb_offset;
+            pb.width = pb_width;
+            pb.height = pb_height;
+            progressbar_bar_draw(ctx, d, &d->bars.tab[i], pb, unit);
             pb_offset += pb_height + d->gap + 2 * (d->border_width + d->border_padding);
         }
     }
@@ -485,11 +637,59 @@ luaA_progressbar_bar_properties_set(lua_State *L)
     for(i = 0; i <= reqs_nbr; i++)
         xcolor_init_reply(reqs[i]);
 
+    bar->chrome_dirty = true;
+
     widget_invalidate_bywidget(*widget);
 
     return 0;
 }
 
+/** Add a value to a progressbar bar.
+ * \param widget The progressbar widget.
+ * \param title The bar name.
+ * \param value The value.
+ */
+static void
+progressbar_bar_data_add(widget_t *widget, const char *title, float value)
+{
+    progressbar_data_t *d = widget->data;
+    bar_t *bar = progressbar_bar_get(&d->bars, title);
+
+    /* a bound bar reads the value from its time series */
+    if(!bar->ts)
+        bar->value = MAX(bar->min_value, MIN(bar->max_value, value));
+}
+
+/** Make a bar read its value from a time series, or keep its own value.
+ * \param widget The progressbar widget.
+ * \param title The bar name.
+ * \param ts The time series, or NULL.
+ */
+static void
+progressbar_bar_data_bind(widget_t *widget, const char *title, timeseries_t *ts)
+{
+    progressbar_data_t *d = widget->data;
+    bar_t *bar = progressbar_bar_get(&d->bars, title);
+
+    if(bar->ts == ts)
+        return;
+
+    if(bar->ts)
+    {
+        /* keep the value the bar was showing */
+        bar->value = progressbar_bar_value(bar);
+        timeseries_binding_remove(bar->ts, widget, title);
+        timeseries_unref(&bar->ts);
+        bar->ts = NULL;
+    }
+
+    if(ts)
+    {
+        bar->ts = timeseries_ref(&ts);
+        timeseries_binding_add(ts, widget, title);
+    }
+}
+
 /** Add a value to a progressbar bar.
  * \param L The Lua VM state.
  * \return The number of elements pushed on the stack.
@@ -502,14 +702,13 @@ static int
 luaA_progressbar_bar_data_add(lua_State *L)
 {
     widget_t **widget = luaA_checkudata(L, 1, "widget");
-    const char *title = luaL_checkstring(L, 2);
     progressbar_data_t *d = (*widget)->data;
-    bar_t *bar;
+    const char *title = luaL_checkstring(L, 2);
 
-    bar = progressbar_bar_get(&d->bars, title);
+    if(progressbar_bar_get(&d->bars, title)->ts)
+        luaL_error(L, "bar is bound to a time series");
 
-    bar->value = luaL_checknumber(L, 3);
-    bar->value = MAX(bar->min_value, MIN(bar->max_value, bar->value));
+    progressbar_bar_data_add(*widget, title, luaL_checknumber(L, 3));
 
     widget_invalidate_bywidget(*widget);
 
@@ -618,6 +817,8 @@ luaA_progressbar_newindex(lua_State *L, awesome_token_t token)
         return 0;
     }
 
+    progressbar_chrome_invalidate(d);
+
     widget_invalidate_bywidget(*widget);
 
     return 0;
@@ -631,6 +832,13 @@ progressbar_destructor(widget_t *widget)
 {
     progressbar_data_t *d = widget->data;
 
+    for(int i = 0; i < d->bars.len; i++)
+        if(d->bars.tab[i].ts)
+        {
+            timeseries_binding_remove(d->bars.tab[i].ts, widget, d->bars.tab[i].title);
+            timeseries_unref(&d->bars.tab[i].ts);
+        }
+
     bar_array_wipe(&d->bars);
     p_delete(&d);
 }
@@ -652,6 +860,8 @@ progressbar_new(alignment_t align)
     w->index = luaA_progressbar_index;
     w->newindex = luaA_progressbar_newindex;
     w->destructor = progressbar_destructor;
+    w->data_add = progressbar_bar_data_add;
+    w->data_bind = progressbar_bar_data_bind;
     w->geometry = progressbar_geometry;
     d = w->data = p_new(progressbar_data_t, 1);
 
@@ -0,0 +1,581 @@
+/*
+ * worker.c - Lua worker thread
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <signal.h>
+
+#include <lualib.h>
+
+#include "structs.h"
+#include "worker.h"
+#include "common/tokenize.h"
+
+extern awesome_t globalconf;
+
+DO_LUA_NEW(static, worker_t, worker, "worker", worker_ref)
+DO_LUA_GC(worker_t, worker, "worker", worker_unref)
+DO_LUA_EQ(worker_t, worker, "worker")
+
+/** Delete a worker. Its thread has been joined.
+ * \param w The worker to delete.
+ */
+void
+worker_delete(worker_t **w)
+{
+    luaL_unref(globalconf.L, LUA_REGISTRYINDEX, (*w)->fct);
+    worker_message_array_wipe(&(*w)->inbox);
+    worker_message_array_wipe(&(*w)->outbox);
+    pthread_mutex_destroy(&(*w)->lock);
+    pthread_cond_destroy(&(*w)->cond);
+    p_delete(&(*w)->error);
+    p_delete(&(*w)->code);
+    p_delete(w);
+}
+
+/** Check that a Lua value can be sent to or from a worker: only booleans,
+ * numbers, strings and tables of them can.
+ * \param L The Lua VM state.
+ * \param idx The value index.
+ * \param depth The nesting level of the value.
+ */
+static void
+worker_value_check(lua_State *L, int idx, int depth)
+{
+    switch(lua_type(L, idx))
+    {
+      case LUA_TBOOLEAN:
+      case LUA_TNUMBER:
+      case LUA_TSTRING:
+        break;
+      case LUA_TTABLE:
+        if(depth >= WORKER_DEPTH_MAX)
+            luaL_error(L, "cannot send tables nested more than %d levels deep",
+                       WORKER_DEPTH_MAX);
+        if(idx < 0)
+            idx = lua_gettop(L) + idx + 1;
+        luaL_checkstack(L, 2, "table too deep");
+        lua_pushnil(L);
+        while(lua_next(L, idx))
+        {
+            worker_value_check(L, -2, depth + 1);
+            worker_value_check(L, -1, depth + 1);
+            lua_pop(L, 1);
+        }
+        break;
+      default:
+        luaL_error(L, "cannot send a %s value", luaL_typename(L, idx));
+    }
+}
+
+/** Serialize a Lua value which passed worker_value_check().
+ * \param L The Lua VM state.
+ * \param idx The value index.
+ * \param buf The buffer to append the value to.
+ */
+static void
+worker_value_write(lua_State *L, int idx, buffer_t *buf)
+{
+    switch(lua_type(L, idx))
+    {
+      case LUA_TBOOLEAN:
+        buffer_addc(buf, 'b');
+        buffer_addc(buf, lua_toboolean(L, idx));
+        break;
+      case LUA_TNUMBER:
+        {
+            lua_Number n = lua_tonumber(L, idx);
+            buffer_addc(buf, 'n');
+            buffer_add(buf, &n, sizeof(n));
+        }
+        break;
+      case LUA_TSTRING:
+        {
+            size_t len;
+            const char *s = lua_tolstring(L, idx, &len);
+            buffer_addc(buf, 's');
+            buffer_add(buf, &len, sizeof(len));
+            buffer_add(buf, s, len);
+        }
+        break;
+      case LUA_TTABLE:
+        if(idx < 0)
+            idx = lua_gettop(L) + idx + 1;
+        buffer_addc(buf, 't');
+        lua_pushnil(L);
+        while(lua_next(L, idx))
+        {
+            worker_value_write(L, -2, buf);
+            worker_value_write(L, -1, buf);
+            lua_pop(L, 1);
+        }
+        buffer_addc(buf, 'e');
+        break;
+    }
+}
+
+/** Serialize a Lua value into a new message.
+ * \param L The Lua VM state.
+ * \param idx The value index.
+ * \return The message.
+ */
+static buffer_t
+worker_message_new(lua_State *L, int idx)
+{
+    buffer_t msg;
+
+    /* check first, so that no error is raised while the buffer is filled */
+    worker_value_check(L, idx, 0);
+    buffer_init(&msg);
+    worker_value_write(L, idx, &msg);
+
+    return msg;
+}
+
+/** Push a serialized Lua value onto the stack.
+ * \param L The Lua VM state.
+ * \param p The serialized value.
+ * \return A pointer past the value.
+ */
+static const char *
+worker_value_push(lua_State *L, const char *p)
+{
+    switch(*p++)
+    {
+      case 'b':
+        lua_pushboolean(L, *p++);
+        break;
+      case 'n':
+        {
+            lua_Number n;
+            memcpy(&n, p, sizeof(n));
+            p += sizeof(n);
+            lua_pushnumber(L, n);
+        }
+        break;
+      case 's':
+        {
+            size_t len;
+            memcpy(&len, p, sizeof(len));
+            p += sizeof(len);
+            lua_pushlstring(L, p, len);
+            p += len;
+        }
+        break;
+      case 't':
+        /* nesting is bounded by WORKER_DEPTH_MAX */
+        lua_checkstack(L, 3);
+        lua_newtable(L);
+        while(*p != 'e')
+        {
+            p = worker_value_push(L, p);
+            p = worker_value_push(L, p);
+            lua_rawset(L, -3);
+        }
+        p++;
+        break;
+    }
+
+    return p;
+}
+
+/** Get the worker a worker Lua state belongs to.
+ * \param L The worker Lua state.
+ * \return The worker.
+ */
+static worker_t *
+worker_get(lua_State *L)
+{
+    worker_t *w;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, WORKER_REGISTRY);
+    w = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    return w;
+}
+
+/** Check whether a worker has to end.
+ * \param w The worker.
+ * \return True if the worker has been terminated.
+ */
+static bool
+worker_terminated(worker_t *w)
+{
+    bool terminate;
+
+    pthread_mutex_lock(&w->lock);
+    terminate = w->terminate;
+    pthread_mutex_unlock(&w->lock);
+
+    return terminate;
+}
+
+/** Abort the worker code once the worker has been terminated.
+ * \param L The worker Lua state.
+ * \param ar The current function.
+ */
+static void
+worker_hook(lua_State *L, lua_Debug *ar)
+{
+    /* raised again until the code returns, so that pcall() cannot
+     * swallow it */
+    if(worker_terminated(worker_get(L)))
+        luaL_error(L, "worker terminated");
+}
+
+/** Send a value to the main Lua state, where the worker function is
+ * called with it.
+ * \param L The worker Lua state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam A boolean, number, string, or table of them.
+ */
+static int
+worker_lua_post(lua_State *L)
+{
+    worker_t *w = worker_get(L);
+    buffer_t msg;
+
+    luaL_checkany(L, 1);
+    msg = worker_message_new(L, 1);
+
+    pthread_mutex_lock(&w->lock);
+    worker_message_array_append(&w->outbox, msg);
+    pthread_mutex_unlock(&w->lock);
+
+    ev_async_send(globalconf.loop, &w->async);
+
+    return 0;
+}
+
+/** Wait for a value sent by the main Lua state.
+ * \param L The worker Lua state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lreturn The value, or nil once the worker has been terminated.
+ */
+static int
+worker_lua_receive(lua_State *L)
+{
+    worker_t *w = worker_get(L);
+    buffer_t msg;
+
+    pthread_mutex_lock(&w->lock);
+    while(!w->inbox.len && !w->terminate)
+        pthread_cond_wait(&w->cond, &w->lock);
+    if(w->terminate)
+    {
+        pthread_mutex_unlock(&w->lock);
+        return 0;
+    }
+    msg = worker_message_array_take(&w->inbox, 0);
+    pthread_mutex_unlock(&w->lock);
+
+    worker_value_push(L, msg.s);
+    buffer_wipe(&msg);
+
+    return 1;
+}
+
+/** Open the libraries available to worker code: no awesome object, nothing
+ * that acts on the whole process.
+ * \param L The worker Lua state.
+ * \param w The worker.
+ */
+static void
+worker_openlibs(lua_State *L, worker_t *w)
+{
+    static const lua_CFunction libs[] =
+    {
+        luaopen_base,
+        luaopen_table,
+        luaopen_string,
+        luaopen_math,
+        luaopen_io,
+        luaopen_os,
+    };
+    static const struct luaL_reg worker_lib[] =
+    {
+        { "post", worker_lua_post },
+        { "receive", worker_lua_receive },
+        { NULL, NULL }
+    };
+
+    for(int i = 0; i < countof(libs); i++)
+    {
+        lua_pushcfunction(L, libs[i]);
+        lua_call(L, 0, 0);
+    }
+
+    /* these would act on awesome itself */
+    lua_getglobal(L, "os");
+    lua_pushnil(L);
+    lua_setfield(L, -2, "exit");
+    lua_pushnil(L);
+    lua_setfield(L, -2, "setlocale");
+    /* children are reaped by the main loop, which would race with these
+     * waiting for their own child */
+    lua_pushnil(L);
+    lua_setfield(L, -2, "execute");
+    lua_pop(L, 1);
+    lua_getglobal(L, "io");
+    lua_pushnil(L);
+    lua_setfield(L, -2, "popen");
+    lua_pop(L, 1);
+
+    luaL_register(L, "worker", worker_lib);
+    lua_pop(L, 1);
+
+    lua_pushlightuserdata(L, w);
+    lua_setfield(L, LUA_REGISTRYINDEX, WORKER_REGISTRY);
+}
+
+/** Run the worker code in its own Lua state.
+ * \param data The worker.
+ * \return NULL.
+ */
+static void *
+worker_thread(void *data)
+{
+    worker_t *w = data;
+    lua_State *L;
+    char *error = NULL;
+
+    if(!(L = luaL_newstate()))
+        error = a_strdup("cannot create Lua state");
+    else
+    {
+        worker_openlibs(L, w);
+        lua_sethook(L, worker_hook, LUA_MASKCOUNT, WORKER_GRANULARITY);
+
+        if((luaL_loadbuffer(L, w->code, w->len, "worker") || lua_pcall(L, 0, 0, 0))
+           && !worker_terminated(w))
+            error = a_strdup(lua_tostring(L, -1));
+
+        lua_close(L);
+    }
+
+    pthread_mutex_lock(&w->lock);
+    w->error = error;
+    w->finished = true;
+    pthread_mutex_unlock(&w->lock);
+
+    ev_async_send(globalconf.loop, &w->async);
+
+    return NULL;
+}
+
+/** Call the worker function with the messages sent by the worker, and reap
+ * it once it is done.
+ */
+static void
+worker_async_cb(EV_P_ ev_async *async, int revents)
+{
+    worker_t *w = async->data;
+    worker_message_array_t outbox;
+    bool finished;
+
+    /* the function may drop the last reference */
+    worker_ref(&w);
+
+    pthread_mutex_lock(&w->lock);
+    outbox = w->outbox;
+    worker_message_array_init(&w->outbox);
+    finished = w->finished;
+    pthread_mutex_unlock(&w->lock);
+
+    for(int i = 0; i < outbox.len; i++)
+    {
+        worker_value_push(globalconf.L, outbox.tab[i].s);
+        luaA_dofunction(globalconf.L, w->fct, 1, 0);
+    }
+    worker_message_array_wipe(&outbox);
+
+    if(finished && w->started)
+    {
+        pthread_join(w->thread, NULL);
+        ev_async_stop(globalconf.loop, &w->async);
+        w->started = false;
+        if(w->error)
+            warn("worker error: %s", w->error);
+        worker_unref(&w);
+    }
+
+    worker_unref(&w);
+}
+
+/** Create a new worker, running Lua code in its own Lua state and thread.
+ * The worker code has the base, table, string, math, io and os libraries,
+ * without `os.exit', `os.setlocale', `os.execute' and `io.popen': programs
+ * have to be run from the main Lua state with `awesome.spawn'. It also has
+ * a `worker' table with `post(value)', to send a value to the function,
+ * and `receive()', to wait for a value sent with `send', or nil once the
+ * worker is terminated. Values are booleans, numbers, strings, or tables of
+ * them, and are copied.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The Lua code of the worker.
+ * \lparam The function called with each value posted by the worker.
+ * \lreturn A brand new worker.
+ */
+static int
+luaA_worker_new(lua_State *L)
+{
+    worker_t *w;
+    size_t len;
+    const char *code = luaL_checklstring(L, 2, &len);
+    sigset_t all, old;
+    int err;
+
+    luaA_checkfunction(L, 3);
+
+    w = p_new(worker_t, 1);
+    w->code = p_new(char, len);
+    memcpy(w->code, code, len);
+    w->len = len;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    luaA_registerfct(L, 3, &w->fct);
+    ev_async_init(&w->async, worker_async_cb);
+    w->async.data = w;
+
+    /* a running worker keeps a reference to itself; the watcher is started
+     * first since starting it drops any ev_async_send() already done */
+    ev_async_start(globalconf.loop, &w->async);
+    w->started = true;
+    worker_ref(&w);
+
+    /* signals are for the main loop */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    err = pthread_create(&w->thread, NULL, worker_thread, w);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if(err)
+    {
+        ev_async_stop(globalconf.loop, &w->async);
+        w->started = false;
+        worker_unref(&w);
+        luaL_error(L, "cannot create worker thread: %s", strerror(err));
+    }
+
+    return luaA_worker_userdata_new(L, w);
+}
+
+/** Send a value to a worker, to be returned by its `receive()'.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A worker.
+ * \lparam A boolean, number, string, or table of them.
+ */
+static int
+luaA_worker_send(lua_State *L)
+{
+    worker_t **w = luaA_checkudata(L, 1, "worker");
+    buffer_t msg;
+
+    luaL_checkany(L, 2);
+    msg = worker_message_new(L, 2);
+
+    pthread_mutex_lock(&(*w)->lock);
+    if((*w)->terminate || (*w)->finished)
+    {
+        pthread_mutex_unlock(&(*w)->lock);
+        buffer_wipe(&msg);
+        luaA_warn(L, "worker is not running");
+        return 0;
+    }
+    worker_message_array_append(&(*w)->inbox, msg);
+    pthread_cond_signal(&(*w)->cond);
+    pthread_mutex_unlock(&(*w)->lock);
+
+    return 0;
+}
+
+/** Terminate a worker: its `receive()' returns nil, and its code is
+ * aborted if it does not return by itself.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lvalue A worker.
+ */
+static int
+luaA_worker_terminate(lua_State *L)
+{
+    worker_t **w = luaA_checkudata(L, 1, "worker");
+
+    pthread_mutex_lock(&(*w)->lock);
+    (*w)->terminate = true;
+    worker_message_array_wipe(&(*w)->inbox);
+    pthread_cond_signal(&(*w)->cond);
+    pthread_mutex_unlock(&(*w)->lock);
+
+    return 0;
+}
+
+/** Worker object.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lfield started True until the worker is done and its posted values have
+ * been handled, read-only.
+ */
+static int
+luaA_worker_index(lua_State *L)
+{
+    if(luaA_usemetatable(L, 1, 2))
+        return 1;
+
+    worker_t **w = luaA_checkudata(L, 1, "worker");
+    size_t len;
+    const char *attr = luaL_checklstring(L, 2, &len);
+
+    switch(a_tokenize(attr, len))
+    {
+      case A_TK_STARTED:
+        lua_pushboolean(L, (*w)->started);
+        break;
+      default:
+        return 0;
+    }
+
+    return 1;
+}
+
+const struct luaL_reg awesome_worker_methods[] =
+{
+    { "__call", luaA_worker_new },
+    { NULL, NULL }
+};
+const struct luaL_reg awesome_worker_meta[] =
+{
+    { "send", luaA_worker_send },
+    { "terminate", luaA_worker_terminate },
+    { "__index", luaA_worker_index },
+    { "__gc", luaA_worker_gc },
+    { "__eq", luaA_worker_eq },
+    { "__tostring", luaA_worker_tostring },
+    { NULL, NULL }
+};
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80
@@ -0,0 +1,81 @@
+/*
+ * worker.h - Lua worker thread header
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_WORKER_H
+#define AWESOME_WORKER_H
+
+#include <ev.h>
+#include <pthread.h>
+
+#include "luaa.h"
+#include "common/array.h"
+#include "common/buffer.h"
+#include "common/refcount.h"
+
+/** Maximum nesting level of tables sent to or from a worker. */
+#define WORKER_DEPTH_MAX 32
+/** Number of Lua instructions between two checks for termination. */
+#define WORKER_GRANULARITY 1000
+/** Registry key of the worker a worker Lua state belongs to. */
+#define WORKER_REGISTRY "awesome.worker"
+
+/** A message is a serialized Lua value */
+DO_ARRAY(buffer_t, worker_message, buffer_wipe)
+
+/** A worker, running Lua code in its own Lua state and thread */
+typedef struct
+{
+    /** Ref count */
+    int refcount;
+    /** The thread */
+    pthread_t thread;
+    /** Protects the fields shared with the thread, below */
+    pthread_mutex_t lock;
+    /** Signaled when a message is sent to the worker or it has to end */
+    pthread_cond_t cond;
+    /** Messages sent to the worker */
+    worker_message_array_t inbox;
+    /** Messages sent by the worker */
+    worker_message_array_t outbox;
+    /** True if the worker has to end */
+    bool terminate;
+    /** True once the thread is done */
+    bool finished;
+    /** Error raised by the worker code */
+    char *error;
+    /** Wakes the main loop up when messages are sent by the worker */
+    struct ev_async async;
+    /** True until the thread has been joined */
+    bool started;
+    /** Lua code of the worker */
+    char *code;
+    /** Length of the code */
+    size_t len;
+    /** Lua function to execute with messages sent by the worker */
+    luaA_ref fct;
+} worker_t;
+
+void worker_delete(worker_t **);
+
+DO_RCNT(worker_t, worker, worker_delete)
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=80